@@ -0,0 +1,206 @@
+#include "SyntheticCorpus.h"
+
+#include <AST/AST.h>
+#include <CodeGen/IRGenerator.h>
+#include <Parse/Lexer.h>
+#include <Parse/Parser.h>
+#include <Parse/Token.h>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+using namespace fantac;
+
+// Hands the parser tokens lexed up front, so it's timed on its own.
+class TokenReplay : public parse::ILexer {
+public:
+  explicit TokenReplay(const std::vector<parse::Token> &Tokens)
+      : Tokens(Tokens) {}
+
+  bool lex(parse::Token &Tok) override {
+    Tok = Tokens[Next];
+    if (Next + 1 < Tokens.size())
+      ++Next;
+    return Tok.Kind != parse::TokenKind::TK_EOF;
+  }
+
+private:
+  const std::vector<parse::Token> &Tokens;
+  size_t Next = 0;
+};
+
+// Counts every node reachable from the top level expressions it visits.
+class NodeCounter : public ast::IASTVisitor {
+public:
+  size_t NumNodes = 0;
+
+  void visit(ast::FunctionDecl &) override { ++NumNodes; }
+  void visit(ast::FunctionDef &AST) override {
+    ++NumNodes;
+    count(AST.Decl);
+    count(AST.Body);
+  }
+  void visit(ast::VariableDecl &AST) override {
+    ++NumNodes;
+    count(AST.AssignmentExpr);
+  }
+  void visit(ast::UnaryOp &AST) override {
+    ++NumNodes;
+    count(AST.Expr);
+  }
+  void visit(ast::BinaryOp &AST) override {
+    ++NumNodes;
+    count(AST.Left);
+    count(AST.Right);
+  }
+  void visit(ast::IfCond &AST) override {
+    ++NumNodes;
+    count(AST.Condition);
+    count(AST.Then);
+    count(AST.Else);
+  }
+  void visit(ast::TernaryCond &AST) override {
+    ++NumNodes;
+    count(AST.Condition);
+    count(AST.Then);
+    count(AST.Else);
+  }
+  void visit(ast::IntegerLiteral &) override { ++NumNodes; }
+  void visit(ast::FloatLiteral &) override { ++NumNodes; }
+  void visit(ast::CharLiteral &) override { ++NumNodes; }
+  void visit(ast::StringLiteral &) override { ++NumNodes; }
+  void visit(ast::VariableRef &) override { ++NumNodes; }
+  void visit(ast::WhileLoop &AST) override {
+    ++NumNodes;
+    count(AST.Condition);
+    count(AST.Body);
+  }
+  void visit(ast::ForLoop &AST) override {
+    ++NumNodes;
+    count(AST.Init);
+    count(AST.Condition);
+    count(AST.Iteration);
+    count(AST.Body);
+  }
+  void visit(ast::MemberAccess &AST) override {
+    ++NumNodes;
+    count(AST.Expr);
+  }
+  void visit(ast::FunctionCall &AST) override {
+    ++NumNodes;
+    count(AST.Args);
+  }
+  void visit(ast::Return &AST) override {
+    ++NumNodes;
+    count(AST.Expr);
+  }
+
+private:
+  void count(ast::IAST *AST) {
+    if (AST)
+      AST->accept(*this);
+  }
+  void count(const ast::ASTList &List) {
+    for (auto *AST : List)
+      AST->accept(*this);
+  }
+};
+
+// Runs a stage a few times and reports its best rate, which is the one least
+// disturbed by whatever else the machine was doing. The stage returns how
+// many units it processed.
+template <typename F>
+void measure(const char *Stage, const char *Unit, F &&Run) {
+  const unsigned int Repetitions = 5;
+  double BestRate = 0;
+  size_t Count = 0;
+  for (unsigned int Repetition = 0; Repetition < Repetitions; ++Repetition) {
+    const auto Start = std::chrono::steady_clock::now();
+    Count = Run();
+    const auto End = std::chrono::steady_clock::now();
+
+    const double Seconds = std::chrono::duration<double>(End - Start).count();
+    BestRate = std::max(BestRate, Count / Seconds);
+  }
+
+  fmt::print("{:<10} {:>8.2f} M {}/s ({} {})\n", Stage, BestRate / 1e6, Unit,
+             Count, Unit);
+}
+
+} // namespace
+
+// Measures the lexer, parser and IR generator separately on a synthetic
+// corpus. Given a path, writes the corpus there instead, so that it can be
+// fed to the compiler itself.
+int main(int argc, char **argv) {
+  const auto Source = bench::makeSyntheticCorpus(bench::CorpusShape());
+  if (argc > 1) {
+    std::ofstream Out(argv[1], std::ios::binary);
+    Out << Source;
+    return Out ? 0 : 1;
+  }
+
+  fmt::print("Corpus of {} KiB\n", Source.size() / 1024);
+  const char *Begin = Source.data();
+  const char *End = Source.data() + Source.size() - 1;
+
+  std::vector<parse::Token> Tokens;
+  parse::Lexer L(Begin, End);
+  parse::Token Tok;
+  while (L.lex(Tok))
+    Tokens.push_back(Tok);
+  Tokens.push_back(Tok);
+
+  // The IR generator works through the same AST every time, which the
+  // parser's timings also count the nodes of.
+  ast::ASTArena Arena;
+  std::vector<ast::IAST *> TopLevelExprs;
+  TokenReplay Replay(Tokens);
+  parse::Parser P(Replay, Arena);
+  NodeCounter Counter;
+  while (auto *AST = P.parseTopLevelExpr()) {
+    AST->accept(Counter);
+    TopLevelExprs.push_back(AST);
+  }
+
+  measure("Lexer", "tokens", [Begin, End]() {
+    parse::Lexer L(Begin, End);
+    parse::Token Tok;
+    size_t NumTokens = 0;
+    while (L.lex(Tok))
+      ++NumTokens;
+    return NumTokens;
+  });
+
+  measure("Parser", "nodes", [&Tokens, &Counter]() {
+    ast::ASTArena Arena;
+    TokenReplay Replay(Tokens);
+    parse::Parser P(Replay, Arena);
+    while (P.parseTopLevelExpr())
+      ;
+    return Counter.NumNodes;
+  });
+
+  measure("IRGen", "instructions", [&TopLevelExprs]() {
+    llvm::LLVMContext Context;
+    codegen::IRGenerator IR(Context);
+    for (auto *AST : TopLevelExprs)
+      AST->accept(IR);
+
+    size_t NumInstructions = 0;
+    for (const auto &F : IR.getModule())
+      NumInstructions += F.getInstructionCount();
+    return NumInstructions;
+  });
+
+  return 0;
+}
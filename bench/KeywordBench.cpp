@@ -0,0 +1,87 @@
+#include <Parse/Keywords.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace fantac::parse;
+
+// The linear scan the lexer used before the perfect hash, kept as a baseline.
+const std::vector<std::pair<std::string, TokenKind>> LinearKeywordMappings(
+    std::begin(KeywordMappings), std::end(KeywordMappings));
+
+TokenKind linearLookup(const std::string &Identifier) {
+  auto KeywordIter = std::find_if(
+      LinearKeywordMappings.begin(), LinearKeywordMappings.end(),
+      [&Identifier](const std::pair<std::string, TokenKind> &KeywordPair) {
+        return Identifier == KeywordPair.first;
+      });
+
+  if (KeywordIter != LinearKeywordMappings.end())
+    return KeywordIter->second;
+
+  return TokenKind::TK_Identifier;
+}
+
+// Deterministic identifier heavy corpus. Roughly a third of the words are
+// keywords and the rest are identifiers that often share a prefix, length or
+// first character with one.
+std::vector<std::string> makeCorpus(size_t NumWords) {
+  const std::vector<std::string> Stems = {
+      "i",     "x",   "count", "index", "in",     "el",     "fo",
+      "value", "ret", "buf",   "data",  "size_t", "doubled"};
+
+  std::mt19937 Generator(42);
+  std::uniform_int_distribution<size_t> Pick(0, 2);
+  std::vector<std::string> Corpus;
+  Corpus.reserve(NumWords);
+
+  for (size_t Index = 0; Index < NumWords; ++Index) {
+    if (Pick(Generator) == 0) {
+      const auto &Mapping =
+          KeywordMappings[Generator() % std::size(KeywordMappings)];
+      Corpus.emplace_back(Mapping.first);
+    } else {
+      auto Word = Stems[Generator() % Stems.size()];
+      if (Generator() % 2)
+        Word += std::to_string(Generator() % 100);
+      Corpus.push_back(std::move(Word));
+    }
+  }
+
+  return Corpus;
+}
+
+template <typename F>
+void run(const char *Name, const std::vector<std::string> &Corpus,
+         unsigned int Iterations, F &&Lookup) {
+  size_t NumKeywords = 0;
+  const auto Start = std::chrono::steady_clock::now();
+  for (unsigned int Iteration = 0; Iteration < Iterations; ++Iteration)
+    for (const auto &Word : Corpus)
+      NumKeywords += Lookup(Word) != TokenKind::TK_Identifier;
+  const auto End = std::chrono::steady_clock::now();
+
+  const double Nanoseconds =
+      std::chrono::duration<double, std::nano>(End - Start).count();
+  fmt::print("{:<14} {:>8.2f} ns/lookup ({} keywords)\n", Name,
+             Nanoseconds / (Corpus.size() * Iterations), NumKeywords);
+}
+
+} // namespace
+
+int main() {
+  const auto Corpus = makeCorpus(1 << 20);
+  const unsigned int Iterations = 10;
+
+  run("find_if", Corpus, Iterations, linearLookup);
+  run("perfect hash", Corpus, Iterations,
+      [](const std::string &Word) { return Keywords.lookup(Word); });
+  return 0;
+}
@@ -0,0 +1,251 @@
+#include "SyntheticCorpus.h"
+
+#include <Parse/Lexer.h>
+#include <Parse/Token.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace fantac;
+
+// The inputs compiled, each stressing a different part of the front end.
+struct Input {
+  const char *Name;
+  bench::CorpusShape Shape;
+};
+
+const Input Inputs[] = {
+    {"functions", {8000, 8, 4, 42}},
+    {"expressions", {500, 256, 4, 43}},
+    {"loops", {500, 8, 128, 44}},
+};
+
+// What a compile of an input cost, as stored in the baseline.
+struct Measurement {
+  size_t Tokens = 0;
+  double Seconds = 0;
+
+  double tokensPerSecond() const { return Tokens / Seconds; }
+};
+
+size_t countTokens(const std::string &Source) {
+  parse::Lexer L(Source.data(), Source.data() + Source.size() - 1);
+  parse::Token Tok;
+  size_t NumTokens = 0;
+  while (L.lex(Tok))
+    ++NumTokens;
+  return NumTokens;
+}
+
+// Compiles a file a few times and returns the quickest, which is the one
+// least disturbed by whatever else the machine was doing.
+bool compile(llvm::StringRef Compiler, const std::string &Source,
+             const std::string &Output, double &BestSeconds) {
+  const unsigned int Repetitions = 5;
+  const llvm::StringRef Args[] = {Compiler, "-o", Output, Source};
+  BestSeconds = 0;
+  for (unsigned int Repetition = 0; Repetition < Repetitions; ++Repetition) {
+    std::string Error;
+    const auto Start = std::chrono::steady_clock::now();
+    const int Status = llvm::sys::ExecuteAndWait(Compiler, Args, llvm::None,
+                                                 {}, 0, 0, &Error);
+    const auto End = std::chrono::steady_clock::now();
+    if (Status != 0) {
+      fmt::print(stderr, "Unable to compile {}: {}.\n", Source,
+                 Error.empty() ? fmt::format("exit status {}", Status)
+                               : Error);
+      return false;
+    }
+
+    const double Seconds = std::chrono::duration<double>(End - Start).count();
+    if (Repetition == 0 || Seconds < BestSeconds)
+      BestSeconds = Seconds;
+  }
+  return true;
+}
+
+// Tells CTest the check was skipped rather than passed or failed.
+const int SkipStatus = 77;
+
+// The baseline has a line for each input with its name, how many tokens it
+// has and how long it took to compile. Lines starting with # are comments.
+bool readBaseline(const std::string &FileName,
+                  std::map<std::string, Measurement> &Baseline) {
+  std::ifstream In(FileName);
+  if (!In) {
+    fmt::print(stderr, "Unable to read baseline {}.\n", FileName);
+    return false;
+  }
+
+  std::string Line;
+  while (std::getline(In, Line)) {
+    if (Line.empty() || Line[0] == '#')
+      continue;
+    std::istringstream Fields(Line);
+    std::string Name;
+    Measurement M;
+    if (!(Fields >> Name >> M.Tokens >> M.Seconds) || M.Seconds <= 0) {
+      fmt::print(stderr, "Malformed line in baseline {}: {}\n", FileName,
+                 Line);
+      return false;
+    }
+    Baseline[Name] = M;
+  }
+  return true;
+}
+
+bool writeBaseline(const std::string &FileName,
+                   const std::vector<Measurement> &Measurements) {
+  std::ofstream Out(FileName);
+  Out << "# Compile-time throughput baseline for fantac_perf_check.\n"
+         "# Timings are only comparable on the machine that recorded them, "
+         "so\n"
+         "# regenerate it with `make fantac_perf_baseline` after moving "
+         "machines.\n"
+         "# input tokens seconds\n";
+  for (size_t Index = 0; Index < Measurements.size(); ++Index)
+    Out << fmt::format("{} {} {:.6f}\n", Inputs[Index].Name,
+                       Measurements[Index].Tokens,
+                       Measurements[Index].Seconds);
+  if (!Out) {
+    fmt::print(stderr, "Unable to write baseline {}.\n", FileName);
+    return false;
+  }
+  return true;
+}
+
+void printUsage() {
+  fmt::print(stderr, "usage: fantac_perf_check FANTAC BASELINE WORK_DIR "
+                     "[--tolerance FRACTION] [--update]\n");
+}
+
+} // namespace
+
+// Compiles a fixed set of large synthetic inputs with the compiler binary
+// and fails if its tokens per second on any of them, or its total time,
+// is worse than the baseline's by more than the tolerance. With --update,
+// records the timings as the new baseline instead. Absolute timings only mean
+// something on the machine that recorded them, so the baseline lives in the
+// build tree and the check is skipped until one has been recorded there.
+int main(int argc, char **argv) {
+  std::vector<std::string> Positional;
+  double Tolerance = 0.25;
+  bool Update = false;
+  for (int Index = 1; Index < argc; ++Index) {
+    const llvm::StringRef Arg = argv[Index];
+    if (Arg == "--update") {
+      Update = true;
+    } else if (Arg == "--tolerance") {
+      if (++Index == argc ||
+          llvm::StringRef(argv[Index]).getAsDouble(Tolerance) ||
+          Tolerance < 0) {
+        printUsage();
+        return 1;
+      }
+    } else {
+      Positional.push_back(Arg.str());
+    }
+  }
+  if (Positional.size() != 3) {
+    printUsage();
+    return 1;
+  }
+
+  const auto &Compiler = Positional[0];
+  const auto &BaselineFileName = Positional[1];
+  const auto &WorkDir = Positional[2];
+  if (!Update && !llvm::sys::fs::exists(BaselineFileName)) {
+    fmt::print("No baseline at {}. Record one on this machine with `make "
+               "fantac_perf_baseline` to run the check.\n",
+               BaselineFileName);
+    return SkipStatus;
+  }
+
+  if (auto Error = llvm::sys::fs::create_directories(WorkDir)) {
+    fmt::print(stderr, "Unable to create {}: {}.\n", WorkDir,
+               Error.message());
+    return 1;
+  }
+
+  std::vector<Measurement> Measurements;
+  for (const auto &I : Inputs) {
+    const auto Source = bench::makeSyntheticCorpus(I.Shape);
+    llvm::SmallString<128> Path(WorkDir);
+    llvm::sys::path::append(Path, std::string(I.Name) + ".c");
+    const auto SourceFileName = Path.str().str();
+    {
+      std::ofstream Out(SourceFileName, std::ios::binary);
+      Out << Source;
+      if (!Out) {
+        fmt::print(stderr, "Unable to write {}.\n", SourceFileName);
+        return 1;
+      }
+    }
+
+    Measurement M;
+    M.Tokens = countTokens(Source);
+    llvm::sys::path::replace_extension(Path, "ll");
+    if (!compile(Compiler, SourceFileName, Path.str().str(), M.Seconds))
+      return 1;
+    Measurements.push_back(M);
+  }
+
+  if (Update)
+    return writeBaseline(BaselineFileName, Measurements) ? 0 : 1;
+
+  std::map<std::string, Measurement> Baseline;
+  if (!readBaseline(BaselineFileName, Baseline))
+    return 1;
+
+  bool Passed = true;
+  double TotalSeconds = 0;
+  double BaselineSeconds = 0;
+  fmt::print("{:<12}{:>16}{:>16}{:>10}\n", "Input", "Tokens/s",
+             "Baseline", "Change");
+  for (size_t Index = 0; Index < Measurements.size(); ++Index) {
+    const auto &M = Measurements[Index];
+    const auto It = Baseline.find(Inputs[Index].Name);
+    if (It == Baseline.end() || It->second.Tokens != M.Tokens) {
+      fmt::print(stderr,
+                 "The baseline for input {} doesn't match how it's generated "
+                 "now. Regenerate it with --update.\n",
+                 Inputs[Index].Name);
+      return 1;
+    }
+
+    const auto &Base = It->second;
+    const double Change = M.tokensPerSecond() / Base.tokensPerSecond() - 1;
+    fmt::print("{:<12}{:>16.0f}{:>16.0f}{:>+9.1f}%\n", Inputs[Index].Name,
+               M.tokensPerSecond(), Base.tokensPerSecond(), Change * 100);
+    if (M.tokensPerSecond() < Base.tokensPerSecond() * (1 - Tolerance))
+      Passed = false;
+    TotalSeconds += M.Seconds;
+    BaselineSeconds += Base.Seconds;
+  }
+
+  const double Change = TotalSeconds / BaselineSeconds - 1;
+  fmt::print("{:<12}{:>15.3f}s{:>15.3f}s{:>+9.1f}%\n", "Total time",
+             TotalSeconds, BaselineSeconds, Change * 100);
+  if (TotalSeconds > BaselineSeconds * (1 + Tolerance))
+    Passed = false;
+
+  if (!Passed)
+    fmt::print(stderr, "Compile-time throughput regressed by more than {}% "
+                       "against the baseline.\n",
+               Tolerance * 100);
+  return Passed ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include "SyntheticCorpus.h"
+
+#include <fmt/format.h>
+
+#include <random>
+
+namespace fantac::bench {
+
+namespace {
+
+class CorpusWriter {
+public:
+  explicit CorpusWriter(const CorpusShape &Shape)
+      : Shape(Shape), Generator(Shape.Seed) {}
+
+  std::string write() {
+    Out += "int printi(int x);\n\n";
+    for (unsigned int Index = 0; Index < Shape.Functions; ++Index)
+      writeFunction(Index);
+    return std::move(Out);
+  }
+
+private:
+  unsigned int pick(unsigned int Bound) { return Generator() % Bound; }
+
+  // The local x can't be used in its own initialiser.
+  std::string leaf(bool UseLocal) {
+    switch (pick(UseLocal ? 4 : 3)) {
+    case 0:
+      return "a";
+    case 1:
+      return "b";
+    case 2:
+      return fmt::format("{}", pick(100));
+    default:
+      return "x";
+    }
+  }
+
+  // The parser has no parentheses, so depth comes from a chain of additions,
+  // which nests one level per operator.
+  std::string expr(unsigned int Depth, bool UseLocal) {
+    auto Expr = leaf(UseLocal);
+    for (unsigned int Level = 0; Level < Depth; ++Level) {
+      Expr += " + ";
+      Expr += leaf(UseLocal);
+    }
+    return Expr;
+  }
+
+  void writeStatement(unsigned int Function) {
+    switch (pick(4)) {
+    case 0:
+      Out += fmt::format("    y = x < y ? y + {} : x + i;\n", pick(100));
+      break;
+    case 1:
+      if (Function > 0) {
+        Out += fmt::format("    x = f{}(x, i);\n", pick(Function));
+        break;
+      }
+      [[fallthrough]];
+    case 2:
+      Out += "    printi(x);\n";
+      break;
+    default:
+      Out += fmt::format("    x = x + {};\n", expr(3, true));
+      break;
+    }
+  }
+
+  void writeFunction(unsigned int Index) {
+    Out += fmt::format("int f{}(int a, int b) {{\n", Index);
+    Out += fmt::format("  int x = {};\n", expr(Shape.ExprDepth, false));
+    Out += "  int y = b;\n";
+    Out += "  int i = 0;\n";
+    Out += fmt::format("  while (i < {}) {{\n", 10 + pick(90));
+    for (unsigned int Statement = 0; Statement < Shape.LoopLength; ++Statement)
+      writeStatement(Index);
+    Out += "    i = i + 1;\n";
+    Out += "  }\n";
+    Out += "  if (x < y) {\n";
+    if (Index > 0)
+      Out += fmt::format("    x = f{}(x, y);\n", pick(Index));
+    else
+      Out += "    x = y;\n";
+    Out += "  } else {\n";
+    Out += "    x = x + y;\n";
+    Out += "  }\n";
+    Out += "  return x;\n";
+    Out += "}\n\n";
+  }
+
+  const CorpusShape &Shape;
+  std::mt19937 Generator;
+  std::string Out;
+};
+
+} // namespace
+
+std::string makeSyntheticCorpus(const CorpusShape &Shape) {
+  return CorpusWriter(Shape).write();
+}
+
+} // namespace fantac::bench
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+namespace fantac::bench {
+
+// Shape of a generated translation unit. Every function is made of one deep
+// expression, a loop with a long body and a branch calling an earlier
+// function, so each front end stage gets a realistic mix of work.
+struct CorpusShape {
+  unsigned int Functions = 2000;
+  // Number of operators in the expression initialising each function's
+  // local, each of which nests it one level deeper.
+  unsigned int ExprDepth = 24;
+  // Number of statements in each function's loop body.
+  unsigned int LoopLength = 16;
+  unsigned int Seed = 42;
+};
+
+// Generates C source that FantaC compiles without errors. The same shape
+// always gives the same source, so timings can be compared across builds.
+std::string makeSyntheticCorpus(const CorpusShape &);
+
+} // namespace fantac::bench
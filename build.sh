@@ -18,6 +18,11 @@ case $build_type in
     "release")
         cmd="cmake -DCMAKE_BUILD_TYPE=Release ../.. && make"
         ;;
+    "perf")
+        # The throughput check runs against the release build.
+        build_type="release"
+        cmd="cmake -DCMAKE_BUILD_TYPE=Release ../.. && make && ctest -L perf --output-on-failure"
+        ;;
     "asan")
         cmd="cmake -DCMAKE_BUILD_TYPE=Debug -DSANITIZER_TYPE=ASan ../.. && make"
         ;;
@@ -1,10 +1,7 @@
 #!/bin/bash
 
-echo "Writing LLVM IR to disk."
-build/release/fantac test.c warn &> test.ll
-
 echo "Compiling to object code."
-llc -filetype=obj -o test.o test.ll
+build/release/fantac -c -o test.o test.c
 
 echo "Linking with test main."
 clang test_main.c test.o -o test
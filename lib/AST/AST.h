@@ -1,10 +1,11 @@
 #pragma once
 
 #include "ASTInterfaces.h"
+#include "Symbol.h"
 
 #include <Parse/Token.h>
 
-#include <vector>
+#include <string_view>
 
 namespace fantac::ast {
 
@@ -73,10 +74,11 @@ inline std::string cTypeToString(const CType &Type) {
 }
 
 struct FunctionDecl : public IAST {
-  template <typename T0, typename T1>
-  FunctionDecl(T0 &&Name, CType Return, T1 &&Args)
-      : Name(std::forward<T0>(Name)), Return(Return),
-        Args(std::forward<T1>(Args)) {}
+  FunctionDecl(Symbol Name, CType Return,
+               ArenaArray<std::pair<Symbol, CType>> Args)
+      : Name(Name), Return(Return), Args(Args) {}
+
+  static constexpr const char *NodeName = "FunctionDecl";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -85,28 +87,24 @@ struct FunctionDecl : public IAST {
     std::string ArgString;
     for (const auto &Arg : Args) {
       ArgString.append(
-          fmt::format("{} {}", cTypeToString(Arg.second), Arg.first));
+          fmt::format("{} {}", cTypeToString(Arg.second), Arg.first.str()));
       if (&Arg != &Args.back())
         ArgString.append(", ");
     }
 
-    return fmt::format("{} {}({})", cTypeToString(Return), Name, ArgString);
+    return fmt::format("{} {}({})", cTypeToString(Return), Name.str(),
+                       ArgString);
   }
 
-  const std::string Name;
+  const Symbol Name;
   const CType Return;
-  const std::vector<std::pair<std::string, CType>> Args;
+  const ArenaArray<std::pair<Symbol, CType>> Args;
 };
 
 struct FunctionDef : public IAST {
-  FunctionDef(std::unique_ptr<FunctionDecl> Decl, std::vector<ASTPtr> &&Body)
-      : Decl(std::move(Decl)), Body(std::move(Body)) {}
+  FunctionDef(FunctionDecl *Decl, ASTList Body) : Decl(Decl), Body(Body) {}
 
-  template <typename T0, typename T1>
-  FunctionDef(T0 &&Name, CType Return, T1 &&Args, std::vector<ASTPtr> &&Body)
-      : Decl(new FunctionDecl(std::forward<T0>(Name), Return,
-                              std::forward<T1>(Args))),
-        Body(std::move(Body)) {}
+  static constexpr const char *NodeName = "FunctionDef";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -119,36 +117,38 @@ struct FunctionDef : public IAST {
     return fmt::format("{}\n{{\n{}}}", Decl->toString(), BodyString);
   }
 
-  const std::unique_ptr<FunctionDecl> Decl;
-  const std::vector<ASTPtr> Body;
+  FunctionDecl *const Decl;
+  const ASTList Body;
 };
 
 struct VariableDecl : public IAST {
-  template <typename T>
-  VariableDecl(CType Type, T &&Name, ASTPtr AssignmentExpr = nullptr)
-      : Type(Type), Name(std::forward<T>(Name)),
-        AssignmentExpr(std::move(AssignmentExpr)) {}
+  VariableDecl(CType Type, Symbol Name, ASTPtr AssignmentExpr = nullptr)
+      : Type(Type), Name(Name), AssignmentExpr(AssignmentExpr) {}
+
+  static constexpr const char *NodeName = "VariableDecl";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
 
   std::string toString() const override {
     if (AssignmentExpr) {
-      return fmt::format("{} {} = {}", cTypeToString(Type), Name,
+      return fmt::format("{} {} = {}", cTypeToString(Type), Name.str(),
                          AssignmentExpr->toString());
     }
 
-    return fmt::format("{} {}", cTypeToString(Type), Name);
+    return fmt::format("{} {}", cTypeToString(Type), Name.str());
   }
 
   const CType Type;
-  const std::string Name;
+  const Symbol Name;
   const ASTPtr AssignmentExpr;
 };
 
 struct UnaryOp : public IAST {
   UnaryOp(parse::TokenKind Operator, ASTPtr Expr)
-      : Operator(Operator), Expr(std::move(Expr)) {}
+      : Operator(Operator), Expr(Expr) {}
+
+  static constexpr const char *NodeName = "UnaryOp";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -164,7 +164,9 @@ struct UnaryOp : public IAST {
 
 struct BinaryOp : public IAST {
   BinaryOp(parse::TokenKind Operator, ASTPtr Left, ASTPtr Right)
-      : Operator(Operator), Left(std::move(Left)), Right(std::move(Right)) {}
+      : Operator(Operator), Left(Left), Right(Right) {}
+
+  static constexpr const char *NodeName = "BinaryOp";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -179,10 +181,10 @@ struct BinaryOp : public IAST {
 };
 
 struct IfCond : public IAST {
-  IfCond(ASTPtr &&Condition, std::vector<ASTPtr> &&Then,
-         std::vector<ASTPtr> &&Else)
-      : Condition(std::move(Condition)), Then(std::move(Then)),
-        Else(std::move(Else)) {}
+  IfCond(ASTPtr Condition, ASTList Then, ASTList Else)
+      : Condition(Condition), Then(Then), Else(Else) {}
+
+  static constexpr const char *NodeName = "IfCond";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); };
@@ -205,13 +207,14 @@ struct IfCond : public IAST {
   }
 
   const ASTPtr Condition;
-  const std::vector<ASTPtr> Then, Else;
+  const ASTList Then, Else;
 };
 
 struct TernaryCond : public IAST {
   TernaryCond(ASTPtr Condition, ASTPtr Then, ASTPtr Else)
-      : Condition(std::move(Condition)), Then(std::move(Then)),
-        Else(std::move(Else)) {}
+      : Condition(Condition), Then(Then), Else(Else) {}
+
+  static constexpr const char *NodeName = "TernaryCond";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -225,8 +228,10 @@ struct TernaryCond : public IAST {
 };
 
 struct WhileLoop : public IAST {
-  WhileLoop(ASTPtr Condition, std::vector<ASTPtr> &&Body)
-      : Condition(std::move(Condition)), Body(std::move(Body)) {}
+  WhileLoop(ASTPtr Condition, ASTList Body)
+      : Condition(Condition), Body(Body) {}
+
+  static constexpr const char *NodeName = "WhileLoop";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -241,14 +246,14 @@ struct WhileLoop : public IAST {
   }
 
   const ASTPtr Condition;
-  const std::vector<ASTPtr> Body;
+  const ASTList Body;
 };
 
 struct ForLoop : public IAST {
-  ForLoop(ASTPtr Init, ASTPtr Condition, ASTPtr Iteration,
-          std::vector<ASTPtr> &&Body)
-      : Init(std::move(Init)), Condition(std::move(Condition)),
-        Iteration(std::move(Iteration)), Body(std::move(Body)) {}
+  ForLoop(ASTPtr Init, ASTPtr Condition, ASTPtr Iteration, ASTList Body)
+      : Init(Init), Condition(Condition), Iteration(Iteration), Body(Body) {}
+
+  static constexpr const char *NodeName = "ForLoop";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -264,12 +269,14 @@ struct ForLoop : public IAST {
   }
 
   const ASTPtr Init, Condition, Iteration;
-  const std::vector<ASTPtr> Body;
+  const ASTList Body;
 };
 
 struct IntegerLiteral : public IAST {
   explicit IntegerLiteral(unsigned int Value) : Value(Value) {}
 
+  static constexpr const char *NodeName = "IntegerLiteral";
+
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
   std::string toString() const override { return fmt::format("{}", Value); }
@@ -280,6 +287,8 @@ struct IntegerLiteral : public IAST {
 struct FloatLiteral : public IAST {
   explicit FloatLiteral(double Value) : Value(Value) {}
 
+  static constexpr const char *NodeName = "FloatLiteral";
+
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
   std::string toString() const override { return fmt::format("{}", Value); }
@@ -290,6 +299,8 @@ struct FloatLiteral : public IAST {
 struct CharLiteral : public IAST {
   explicit CharLiteral(char Value) : Value(Value) {}
 
+  static constexpr const char *NodeName = "CharLiteral";
+
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
   std::string toString() const override { return fmt::format("\'{}\'", Value); }
@@ -298,47 +309,51 @@ struct CharLiteral : public IAST {
 };
 
 struct StringLiteral : public IAST {
-  template <typename T>
-  explicit StringLiteral(T &&Value) : Value(std::forward<T>(Value)) {}
+  // Value must outlive the node, such as by being owned by its arena.
+  explicit StringLiteral(std::string_view Value) : Value(Value) {}
+
+  static constexpr const char *NodeName = "StringLiteral";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
   std::string toString() const override { return fmt::format("\"{}\"", Value); }
 
-  const std::string Value;
+  const std::string_view Value;
 };
 
 struct VariableRef : public IAST {
-  template <typename T>
-  explicit VariableRef(T &&Name) : Name(std::forward<T>(Name)) {}
+  explicit VariableRef(Symbol Name) : Name(Name) {}
+
+  static constexpr const char *NodeName = "VariableRef";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
-  std::string toString() const override { return Name; }
+  std::string toString() const override { return std::string(Name.str()); }
 
-  const std::string Name;
+  const Symbol Name;
 };
 
 struct MemberAccess : public IAST {
-  template <typename T>
-  MemberAccess(ASTPtr Expr, T &&MemberName)
-      : Expr(std::move(Expr)), MemberName(std::forward<T>(MemberName)) {}
+  MemberAccess(ASTPtr Expr, Symbol MemberName)
+      : Expr(Expr), MemberName(MemberName) {}
+
+  static constexpr const char *NodeName = "MemberAccess";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
 
   std::string toString() const override {
-    return fmt::format("{}.{}", Expr->toString(), MemberName);
+    return fmt::format("{}.{}", Expr->toString(), MemberName.str());
   }
 
   const ASTPtr Expr;
-  const std::string MemberName;
+  const Symbol MemberName;
 };
 
 struct FunctionCall : public IAST {
-  template <typename T>
-  FunctionCall(T &&Name, std::vector<ASTPtr> &&Args)
-      : Name(std::forward<T>(Name)), Args(std::move(Args)) {}
+  FunctionCall(Symbol Name, ASTList Args) : Name(Name), Args(Args) {}
+
+  static constexpr const char *NodeName = "FunctionCall";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -347,19 +362,21 @@ struct FunctionCall : public IAST {
     std::string ArgString;
     for (const auto &Arg : Args) {
       ArgString.append(Arg->toString());
-      if (Arg.get() != Args.back().get())
+      if (Arg != Args.back())
         ArgString.append(", ");
     }
 
-    return fmt::format("{}({})", Name, ArgString);
+    return fmt::format("{}({})", Name.str(), ArgString);
   }
 
-  const std::string Name;
-  const std::vector<ASTPtr> Args;
+  const Symbol Name;
+  const ASTList Args;
 };
 
 struct Return : public IAST {
-  explicit Return(ASTPtr Expr) : Expr(std::move(Expr)) {}
+  explicit Return(ASTPtr Expr) : Expr(Expr) {}
+
+  static constexpr const char *NodeName = "Return";
 
   // IAST impl.
   void accept(IASTVisitor &Visitor) override { Visitor.visit(*this); }
@@ -0,0 +1,51 @@
+#include "ASTArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace fantac::ast {
+
+namespace {
+
+constexpr size_t SlabSize = 64 * 1024;
+
+stats::Counter StringsCopied("ast", "Strings copied into arenas");
+stats::Counter SlabsAllocated("ast", "Arena slabs allocated");
+
+} // namespace
+
+std::string_view ASTArena::copyString(std::string_view Str) {
+  if (Str.empty())
+    return std::string_view();
+
+  StringsCopied.add();
+  auto *Data = static_cast<char *>(allocate(Str.size(), alignof(char)));
+  std::memcpy(Data, Str.data(), Str.size());
+  return std::string_view(Data, Str.size());
+}
+
+void ASTArena::reset() {
+  Slabs.clear();
+  Current = End = nullptr;
+}
+
+void *ASTArena::allocateSlow(size_t Size, size_t Alignment) {
+  // Oversized requests get a slab of their own so the current one keeps
+  // serving small nodes.
+  SlabsAllocated.add();
+  const size_t NewSlabSize = std::max(SlabSize, Size + Alignment);
+  Slabs.emplace_back(new char[NewSlabSize]);
+  BytesReserved += NewSlabSize;
+
+  char *Slab = Slabs.back().get();
+  const auto Address = reinterpret_cast<uintptr_t>(Slab);
+  const auto Aligned = (Address + Alignment - 1) & ~(Alignment - 1);
+  if (NewSlabSize == SlabSize) {
+    Current = reinterpret_cast<char *>(Aligned + Size);
+    End = Slab + NewSlabSize;
+  }
+
+  return reinterpret_cast<void *>(Aligned);
+}
+
+} // namespace fantac::ast
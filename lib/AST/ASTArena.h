@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Support/Statistics.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fantac::ast {
+
+// Fixed size array allocated in an ASTArena.
+template <typename T> class ArenaArray {
+public:
+  ArenaArray() = default;
+  ArenaArray(const T *Data, size_t Size) : Data(Data), Size(Size) {}
+
+  const T *begin() const { return Data; }
+  const T *end() const { return Data + Size; }
+  const T &operator[](size_t Index) const { return Data[Index]; }
+  const T &back() const { return Data[Size - 1]; }
+  size_t size() const { return Size; }
+  bool empty() const { return Size == 0; }
+
+private:
+  const T *Data = nullptr;
+  size_t Size = 0;
+};
+
+// Bump allocator owning every AST node of a translation unit along with their
+// child arrays and strings. Everything is released at once when the arena is
+// destroyed and node destructors are never run, so nodes may only hold
+// trivially destructible members or memory that the arena itself owns.
+class ASTArena {
+public:
+  ASTArena() = default;
+  ASTArena(const ASTArena &) = delete;
+  ASTArena &operator=(const ASTArena &) = delete;
+
+  template <typename T, typename... Args> T *create(Args &&... Arguments) {
+#if FANTAC_STATS
+    static stats::Counter Nodes("ast", std::string("Nodes of type ") +
+                                           T::NodeName);
+    Nodes.add();
+#endif
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(Arguments)...);
+  }
+
+  template <typename T> ArenaArray<T> copyArray(const T *Begin, size_t Size) {
+    if (Size == 0)
+      return ArenaArray<T>();
+
+    auto *Data = static_cast<T *>(allocate(sizeof(T) * Size, alignof(T)));
+    std::uninitialized_copy(Begin, Begin + Size, Data);
+    return ArenaArray<T>(Data, Size);
+  }
+
+  std::string_view copyString(std::string_view Str);
+  // Frees everything allocated so far at once. Nothing created before may be
+  // used afterwards.
+  void reset();
+
+  void *allocate(size_t Size, size_t Alignment) {
+    const auto Address = reinterpret_cast<uintptr_t>(Current);
+    const auto Aligned = (Address + Alignment - 1) & ~(Alignment - 1);
+    if (Current && Aligned + Size <= reinterpret_cast<uintptr_t>(End)) {
+      Current = reinterpret_cast<char *>(Aligned + Size);
+      return reinterpret_cast<void *>(Aligned);
+    }
+
+    return allocateSlow(Size, Alignment);
+  }
+
+  // Total bytes reserved from the system so far.
+  size_t bytesReserved() const { return BytesReserved; }
+
+private:
+  void *allocateSlow(size_t Size, size_t Alignment);
+
+  std::vector<std::unique_ptr<char[]>> Slabs;
+  char *Current = nullptr, *End = nullptr;
+  size_t BytesReserved = 0;
+};
+
+} // namespace fantac::ast
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ASTArena.h"
+
 #include <fmt/format.h>
 
 #include <memory>
@@ -55,7 +57,8 @@ public:
   virtual void visit(Return &) = 0;
 };
 
-// Base class for all AST nodes.
+// Base class for all AST nodes. Each type of node also has a static NodeName
+// naming it, which --stats counts them by.
 struct IAST {
   virtual ~IAST() = default;
 
@@ -65,6 +68,8 @@ struct IAST {
   llvm::Value *LLVMValue = nullptr;
 };
 
-using ASTPtr = std::unique_ptr<IAST>;
+// Nodes are owned by the ASTArena they were created in.
+using ASTPtr = IAST *;
+using ASTList = ArenaArray<ASTPtr>;
 
 } // namespace fantac::ast
@@ -0,0 +1,493 @@
+#include "ASTSerialization.h"
+#include "AST.h"
+
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstring>
+
+namespace fantac::ast {
+
+namespace {
+
+// The file starts with a header holding the size of each of the following
+// arrays, in order: symbols as offset and size into the string data, nodes,
+// child lists, function arguments as symbol, type and pointer depth, and the
+// top level nodes. The string data comes last. Every integer is a little
+// endian 32 bit word and there's no padding, so the file can be read in place
+// from any address.
+constexpr char ASTMagic[8] = {'F', 'A', 'N', 'T', 'A', 'A', 'S', 'T'};
+// Bump this whenever the layout or any of the serialised enums change.
+constexpr uint32_t ASTVersion = 1;
+constexpr uint32_t NullNode = UINT32_MAX;
+constexpr unsigned int NumFields = 5;
+// Every level of indirection is another LLVM type, so refuse absurd ones
+// rather than trying to build them.
+constexpr uint32_t MaxPointer = 1024;
+
+// Nodes are a kind and five fields. Fields refer to other nodes by number,
+// and to lists as the first entry and count in the child lists:
+//   FunctionDecl:   Name, Return type, Return pointers, Args first, Args count
+//   FunctionDef:    Decl, Body first, Body count
+//   VariableDecl:   Type, Pointers, Name, AssignmentExpr or NullNode
+//   UnaryOp:        Operator, Expr
+//   BinaryOp:       Operator, Left, Right
+//   IfCond:         Condition, Then first, Then count, Else first, Else count
+//   TernaryCond:    Condition, Then, Else
+//   IntegerLiteral: Value
+//   FloatLiteral:   Low word, High word of the double
+//   CharLiteral:    Value
+//   StringLiteral:  String offset, Size
+//   VariableRef:    Name
+//   WhileLoop:      Condition, Body first, Body count
+//   ForLoop:        Init, Condition, Iteration, Body first, Body count
+//   MemberAccess:   Expr, MemberName
+//   FunctionCall:   Name, Args first, Args count
+//   Return:         Expr or NullNode
+// Types are packed as the type kind, then the length kind shifted by 8 and
+// whether it's signed shifted by 16.
+enum NodeKind : uint32_t {
+  NK_FunctionDecl,
+  NK_FunctionDef,
+  NK_VariableDecl,
+  NK_UnaryOp,
+  NK_BinaryOp,
+  NK_IfCond,
+  NK_TernaryCond,
+  NK_IntegerLiteral,
+  NK_FloatLiteral,
+  NK_CharLiteral,
+  NK_StringLiteral,
+  NK_VariableRef,
+  NK_WhileLoop,
+  NK_ForLoop,
+  NK_MemberAccess,
+  NK_FunctionCall,
+  NK_Return,
+};
+
+uint32_t packType(const CType &Type) {
+  return static_cast<uint32_t>(Type.Type) |
+         static_cast<uint32_t>(Type.Length) << 8 |
+         static_cast<uint32_t>(Type.Signed) << 16;
+}
+
+SerializationException corrupt() {
+  return SerializationException("Serialised AST is corrupt.");
+}
+
+CType unpackType(uint32_t Packed, uint32_t Pointer) {
+  const auto Type = Packed & 0xFF;
+  const auto Length = Packed >> 8 & 0xFF;
+  const auto Signed = Packed >> 16;
+  if (Type > static_cast<uint32_t>(CTypeKind::CTK_Void) ||
+      Length > static_cast<uint32_t>(CLengthKind::CLK_LongLong) || Signed > 1 ||
+      Pointer > MaxPointer)
+    throw corrupt();
+
+  return CType(static_cast<CTypeKind>(Type), static_cast<CLengthKind>(Length),
+               Signed != 0, Pointer);
+}
+
+parse::TokenKind toOperator(uint32_t Operator) {
+  if (Operator >= static_cast<uint32_t>(parse::TokenKind::TK_None))
+    throw corrupt();
+
+  return static_cast<parse::TokenKind>(Operator);
+}
+
+bool isInRange(uint32_t First, uint32_t Count, uint32_t Size) {
+  return static_cast<uint64_t>(First) + Count <= Size;
+}
+
+} // namespace
+
+void ASTWriter::write(llvm::raw_ostream &Out) const {
+  llvm::support::endian::Writer W(Out, llvm::support::little);
+  Out.write(ASTMagic, sizeof(ASTMagic));
+  W.write<uint32_t>(ASTVersion);
+  W.write<uint32_t>(Symbols.size() / 2);
+  W.write<uint32_t>(NumNodes);
+  W.write<uint32_t>(Children.size());
+  W.write<uint32_t>(Args.size() / 3);
+  W.write<uint32_t>(TopLevel.size());
+  W.write<uint32_t>(Strings.size());
+
+  for (const auto *Array : {&Symbols, &Nodes, &Children, &Args, &TopLevel})
+    W.write(llvm::makeArrayRef(*Array));
+
+  Out << Strings;
+}
+
+void ASTWriter::visit(FunctionDecl &AST) {
+  const auto First = static_cast<uint32_t>(Args.size() / 3);
+  for (const auto &Arg : AST.Args) {
+    Args.push_back(addSymbol(Arg.first));
+    Args.push_back(packType(Arg.second));
+    Args.push_back(Arg.second.Pointer);
+  }
+
+  finishNode(AST, NK_FunctionDecl,
+             {addSymbol(AST.Name), packType(AST.Return), AST.Return.Pointer,
+              First, static_cast<uint32_t>(AST.Args.size())});
+}
+
+void ASTWriter::visit(FunctionDef &AST) {
+  const auto Decl = addNode(AST.Decl);
+  const auto Body = addList(AST.Body);
+  finishNode(AST, NK_FunctionDef, {Decl, Body.first, Body.second});
+}
+
+void ASTWriter::visit(VariableDecl &AST) {
+  const auto AssignmentExpr = addNode(AST.AssignmentExpr);
+  finishNode(AST, NK_VariableDecl,
+             {packType(AST.Type), AST.Type.Pointer, addSymbol(AST.Name),
+              AssignmentExpr});
+}
+
+void ASTWriter::visit(UnaryOp &AST) {
+  const auto Expr = addNode(AST.Expr);
+  finishNode(AST, NK_UnaryOp, {static_cast<uint32_t>(AST.Operator), Expr});
+}
+
+void ASTWriter::visit(BinaryOp &AST) {
+  const auto Left = addNode(AST.Left);
+  const auto Right = addNode(AST.Right);
+  finishNode(AST, NK_BinaryOp,
+             {static_cast<uint32_t>(AST.Operator), Left, Right});
+}
+
+void ASTWriter::visit(IfCond &AST) {
+  const auto Condition = addNode(AST.Condition);
+  const auto Then = addList(AST.Then);
+  const auto Else = addList(AST.Else);
+  finishNode(AST, NK_IfCond,
+             {Condition, Then.first, Then.second, Else.first, Else.second});
+}
+
+void ASTWriter::visit(TernaryCond &AST) {
+  const auto Condition = addNode(AST.Condition);
+  const auto Then = addNode(AST.Then);
+  const auto Else = addNode(AST.Else);
+  finishNode(AST, NK_TernaryCond, {Condition, Then, Else});
+}
+
+void ASTWriter::visit(IntegerLiteral &AST) {
+  finishNode(AST, NK_IntegerLiteral, {AST.Value});
+}
+
+void ASTWriter::visit(FloatLiteral &AST) {
+  uint64_t Bits;
+  std::memcpy(&Bits, &AST.Value, sizeof(Bits));
+  finishNode(AST, NK_FloatLiteral,
+             {static_cast<uint32_t>(Bits), static_cast<uint32_t>(Bits >> 32)});
+}
+
+void ASTWriter::visit(CharLiteral &AST) {
+  finishNode(AST, NK_CharLiteral, {static_cast<unsigned char>(AST.Value)});
+}
+
+void ASTWriter::visit(StringLiteral &AST) {
+  const auto String = addString(AST.Value);
+  finishNode(AST, NK_StringLiteral, {String.first, String.second});
+}
+
+void ASTWriter::visit(VariableRef &AST) {
+  finishNode(AST, NK_VariableRef, {addSymbol(AST.Name)});
+}
+
+void ASTWriter::visit(WhileLoop &AST) {
+  const auto Condition = addNode(AST.Condition);
+  const auto Body = addList(AST.Body);
+  finishNode(AST, NK_WhileLoop, {Condition, Body.first, Body.second});
+}
+
+void ASTWriter::visit(ForLoop &AST) {
+  const auto Init = addNode(AST.Init);
+  const auto Condition = addNode(AST.Condition);
+  const auto Iteration = addNode(AST.Iteration);
+  const auto Body = addList(AST.Body);
+  finishNode(AST, NK_ForLoop,
+             {Init, Condition, Iteration, Body.first, Body.second});
+}
+
+void ASTWriter::visit(MemberAccess &AST) {
+  const auto Expr = addNode(AST.Expr);
+  finishNode(AST, NK_MemberAccess, {Expr, addSymbol(AST.MemberName)});
+}
+
+void ASTWriter::visit(FunctionCall &AST) {
+  const auto CallArgs = addList(AST.Args);
+  finishNode(AST, NK_FunctionCall,
+             {addSymbol(AST.Name), CallArgs.first, CallArgs.second});
+}
+
+void ASTWriter::visit(Return &AST) {
+  finishNode(AST, NK_Return, {addNode(AST.Expr)});
+}
+
+uint32_t ASTWriter::addNode(IAST *Node) {
+  if (!Node)
+    return NullNode;
+
+  const auto Found = NodeIndices.find(Node);
+  if (Found != NodeIndices.end())
+    return Found->second;
+
+  ++Depth;
+  Node->accept(*this);
+  --Depth;
+  return LastNode;
+}
+
+uint32_t ASTWriter::addSymbol(Symbol Name) {
+  const auto Inserted = SymbolIndices.try_emplace(
+      Name.id(), static_cast<uint32_t>(Symbols.size() / 2));
+  if (Inserted.second) {
+    const auto String = addString(Name.str());
+    Symbols.push_back(String.first);
+    Symbols.push_back(String.second);
+  }
+
+  return Inserted.first->second;
+}
+
+std::pair<uint32_t, uint32_t> ASTWriter::addString(std::string_view Str) {
+  const auto Offset = static_cast<uint32_t>(Strings.size());
+  Strings.append(Str);
+  return {Offset, static_cast<uint32_t>(Str.size())};
+}
+
+std::pair<uint32_t, uint32_t>
+ASTWriter::addList(const ArenaArray<IAST *> &List) {
+  // Children add lists of their own, so only append this one at the end.
+  std::vector<uint32_t> Indices;
+  Indices.reserve(List.size());
+  for (auto *Node : List)
+    Indices.push_back(addNode(Node));
+
+  const auto First = static_cast<uint32_t>(Children.size());
+  Children.insert(Children.end(), Indices.begin(), Indices.end());
+  return {First, static_cast<uint32_t>(Indices.size())};
+}
+
+void ASTWriter::finishNode(IAST &AST, uint32_t Kind,
+                           std::vector<uint32_t> Fields) {
+  Fields.resize(NumFields);
+  Nodes.push_back(Kind);
+  Nodes.insert(Nodes.end(), Fields.begin(), Fields.end());
+
+  LastNode = NumNodes++;
+  NodeIndices[&AST] = LastNode;
+
+  // Top level expressions never share nodes, so each can be freed once it's
+  // been read.
+  if (Depth == 0) {
+    TopLevel.push_back(LastNode);
+    NodeIndices.clear();
+  }
+}
+
+struct ASTReader::Header {
+  char Magic[8];
+  Word Version;
+  Word NumSymbols;
+  Word NumNodes;
+  Word NumChildren;
+  Word NumArgs;
+  Word NumTopLevel;
+  Word StringsSize;
+};
+
+struct ASTReader::NodeEntry {
+  Word Kind;
+  Word Fields[NumFields];
+};
+
+ASTReader::ASTReader(std::string_view Data, ASTArena &Arena) : Arena(Arena) {
+  static_assert(alignof(Header) == 1 && alignof(NodeEntry) == 1,
+                "Entries must be readable from any address.");
+
+  const auto *Current = Data.data();
+  const auto *End = Data.data() + Data.size();
+  const auto take = [&Current, End](size_t Size, size_t Count) {
+    if (Count > static_cast<size_t>(End - Current) / Size)
+      throw SerializationException("Serialised AST is truncated.");
+
+    const auto *Array = Current;
+    Current += Size * Count;
+    return Array;
+  };
+
+  FileHeader = reinterpret_cast<const Header *>(take(sizeof(Header), 1));
+  if (std::memcmp(FileHeader->Magic, ASTMagic, sizeof(ASTMagic)) != 0 ||
+      FileHeader->Version != ASTVersion)
+    throw SerializationException(
+        "Not a serialised AST written by this version of fantac.");
+
+  Symbols = reinterpret_cast<const Word *>(
+      take(2 * sizeof(Word), FileHeader->NumSymbols));
+  Nodes = reinterpret_cast<const NodeEntry *>(
+      take(sizeof(NodeEntry), FileHeader->NumNodes));
+  Children = reinterpret_cast<const Word *>(
+      take(sizeof(Word), FileHeader->NumChildren));
+  Args = reinterpret_cast<const Word *>(
+      take(3 * sizeof(Word), FileHeader->NumArgs));
+  TopLevel = reinterpret_cast<const Word *>(
+      take(sizeof(Word), FileHeader->NumTopLevel));
+  Strings = take(1, FileHeader->StringsSize);
+
+  Built.resize(FileHeader->NumNodes);
+  Interned.resize(FileHeader->NumSymbols);
+}
+
+IAST *ASTReader::parseTopLevelExpr() {
+  if (NextTopLevel == FileHeader->NumTopLevel)
+    return nullptr;
+
+  // Nodes are in post-order, so a top level node comes right after the rest
+  // of its nodes.
+  const uint32_t Top = TopLevel[NextTopLevel++];
+  if (Top < NextNode || Top >= FileHeader->NumNodes || !isFunction(Top))
+    throw corrupt();
+
+  FirstNode = NextNode;
+  for (; NextNode <= Top; ++NextNode)
+    Built[NextNode] = buildNode(NextNode);
+
+  return Built[Top];
+}
+
+IAST *ASTReader::buildNode(uint32_t Index) {
+  const auto &Entry = Nodes[Index];
+  const auto Field = [&Entry](unsigned int Number) -> uint32_t {
+    return Entry.Fields[Number];
+  };
+
+  switch (Entry.Kind) {
+  case NK_FunctionDecl: {
+    if (!isInRange(Field(3), Field(4), FileHeader->NumArgs))
+      throw corrupt();
+
+    std::vector<std::pair<Symbol, CType>> DeclArgs;
+    for (uint32_t Arg = Field(3); Arg < Field(3) + Field(4); ++Arg)
+      DeclArgs.emplace_back(getSymbol(Args[3 * Arg]),
+                            unpackType(Args[3 * Arg + 1], Args[3 * Arg + 2]));
+
+    return Arena.create<FunctionDecl>(
+        getSymbol(Field(0)), unpackType(Field(1), Field(2)),
+        Arena.copyArray(DeclArgs.data(), DeclArgs.size()));
+  }
+  case NK_FunctionDef: {
+    if (Field(0) < FirstNode || Field(0) >= Index ||
+        Nodes[Field(0)].Kind != NK_FunctionDecl)
+      throw corrupt();
+
+    return Arena.create<FunctionDef>(
+        static_cast<FunctionDecl *>(Built[Field(0)]),
+        getList(Field(1), Field(2), Index));
+  }
+  case NK_VariableDecl:
+    return Arena.create<VariableDecl>(unpackType(Field(0), Field(1)),
+                                      getSymbol(Field(2)),
+                                      getNode(Field(3), Index, true));
+  case NK_UnaryOp:
+    return Arena.create<UnaryOp>(toOperator(Field(0)),
+                                 getNode(Field(1), Index));
+  case NK_BinaryOp:
+    return Arena.create<BinaryOp>(toOperator(Field(0)),
+                                  getNode(Field(1), Index),
+                                  getNode(Field(2), Index));
+  case NK_IfCond:
+    return Arena.create<IfCond>(getNode(Field(0), Index),
+                                getList(Field(1), Field(2), Index),
+                                getList(Field(3), Field(4), Index));
+  case NK_TernaryCond:
+    return Arena.create<TernaryCond>(getNode(Field(0), Index),
+                                     getNode(Field(1), Index),
+                                     getNode(Field(2), Index));
+  case NK_IntegerLiteral:
+    return Arena.create<IntegerLiteral>(Field(0));
+  case NK_FloatLiteral: {
+    const auto Bits =
+        static_cast<uint64_t>(Field(1)) << 32 | static_cast<uint64_t>(Field(0));
+    double Value;
+    std::memcpy(&Value, &Bits, sizeof(Value));
+    return Arena.create<FloatLiteral>(Value);
+  }
+  case NK_CharLiteral:
+    return Arena.create<CharLiteral>(static_cast<char>(Field(0)));
+  case NK_StringLiteral:
+    return Arena.create<StringLiteral>(getString(Field(0), Field(1)));
+  case NK_VariableRef:
+    return Arena.create<VariableRef>(getSymbol(Field(0)));
+  case NK_WhileLoop:
+    return Arena.create<WhileLoop>(getNode(Field(0), Index),
+                                   getList(Field(1), Field(2), Index));
+  case NK_ForLoop:
+    return Arena.create<ForLoop>(
+        getNode(Field(0), Index), getNode(Field(1), Index),
+        getNode(Field(2), Index), getList(Field(3), Field(4), Index));
+  case NK_MemberAccess:
+    return Arena.create<MemberAccess>(getNode(Field(0), Index),
+                                      getSymbol(Field(1)));
+  case NK_FunctionCall:
+    return Arena.create<FunctionCall>(getSymbol(Field(0)),
+                                      getList(Field(1), Field(2), Index));
+  case NK_Return:
+    return Arena.create<Return>(getNode(Field(0), Index, true));
+  default:
+    throw corrupt();
+  }
+}
+
+IAST *ASTReader::getNode(uint32_t Index, uint32_t Parent, bool Optional) {
+  if (Index == NullNode && Optional)
+    return nullptr;
+
+  // Children always come before their parents, in the same top level
+  // expression. Functions are only ever top level expressions, aside from the
+  // declaration of a definition.
+  if (Index < FirstNode || Index >= Parent || isFunction(Index))
+    throw corrupt();
+
+  return Built[Index];
+}
+
+bool ASTReader::isFunction(uint32_t Index) const {
+  return Nodes[Index].Kind == NK_FunctionDecl ||
+         Nodes[Index].Kind == NK_FunctionDef;
+}
+
+ASTList ASTReader::getList(uint32_t First, uint32_t Count, uint32_t Parent) {
+  if (!isInRange(First, Count, FileHeader->NumChildren))
+    throw corrupt();
+
+  Scratch.clear();
+  for (uint32_t Child = First; Child < First + Count; ++Child)
+    Scratch.push_back(getNode(Children[Child], Parent));
+
+  return Arena.copyArray(Scratch.data(), Scratch.size());
+}
+
+Symbol ASTReader::getSymbol(uint32_t Index) {
+  if (Index >= FileHeader->NumSymbols)
+    throw corrupt();
+
+  // Only intern the names that are actually used.
+  auto &Interned = this->Interned[Index];
+  if (!Interned)
+    Interned = Symbol::intern(
+        getString(Symbols[2 * Index], Symbols[2 * Index + 1]));
+
+  return *Interned;
+}
+
+std::string_view ASTReader::getString(uint32_t Offset, uint32_t Size) const {
+  if (!isInRange(Offset, Size, FileHeader->StringsSize))
+    throw corrupt();
+
+  return std::string_view(Strings + Offset, Size);
+}
+
+} // namespace fantac::ast
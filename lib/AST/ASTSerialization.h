@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ASTArena.h"
+#include "ASTInterfaces.h"
+#include "Symbol.h"
+
+#include <Parse/ParseInterfaces.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/Endian.h>
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+
+} // namespace llvm
+
+namespace fantac::ast {
+
+class SerializationException : public std::runtime_error {
+public:
+  template <typename T>
+  explicit SerializationException(T &&Error)
+      : std::runtime_error(std::forward<T>(Error)) {}
+  virtual ~SerializationException() = default;
+};
+
+// Flattens top level expressions into the serialised AST format. Nodes are
+// numbered in post-order and refer to each other by number, so the tree is a
+// handful of flat arrays with no pointers in it. Everything is copied as it's
+// visited, so the nodes don't need to outlive the writer.
+class ASTWriter : public IASTVisitor {
+public:
+  ASTWriter() = default;
+  virtual ~ASTWriter() = default;
+
+  void write(llvm::raw_ostream &) const;
+
+  // IASTVisitor impl. Nodes visited from outside the writer are top level
+  // expressions.
+  void visit(FunctionDecl &) override;
+  void visit(FunctionDef &) override;
+  void visit(VariableDecl &) override;
+  void visit(UnaryOp &) override;
+  void visit(BinaryOp &) override;
+  void visit(IfCond &) override;
+  void visit(TernaryCond &) override;
+  void visit(IntegerLiteral &) override;
+  void visit(FloatLiteral &) override;
+  void visit(CharLiteral &) override;
+  void visit(StringLiteral &) override;
+  void visit(VariableRef &) override;
+  void visit(WhileLoop &) override;
+  void visit(ForLoop &) override;
+  void visit(MemberAccess &) override;
+  void visit(FunctionCall &) override;
+  void visit(Return &) override;
+
+private:
+  uint32_t addNode(IAST *);
+  uint32_t addSymbol(Symbol);
+  std::pair<uint32_t, uint32_t> addString(std::string_view);
+  std::pair<uint32_t, uint32_t> addList(const ArenaArray<IAST *> &);
+  void finishNode(IAST &, uint32_t Kind, std::vector<uint32_t> Fields);
+
+  // Each node is its kind followed by its fields.
+  std::vector<uint32_t> Nodes;
+  std::vector<uint32_t> Children;
+  std::vector<uint32_t> Args;
+  std::vector<uint32_t> TopLevel;
+  std::vector<uint32_t> Symbols;
+  std::string Strings;
+  // Node numbers by node, so shared nodes are only written once.
+  llvm::DenseMap<const IAST *, uint32_t> NodeIndices;
+  // Symbol numbers by ast::Symbol id.
+  llvm::DenseMap<uint32_t, uint32_t> SymbolIndices;
+  uint32_t NumNodes = 0;
+  unsigned int Depth = 0;
+  uint32_t LastNode = 0;
+};
+
+// Reads a serialised AST in place, such as straight out of a memory mapped
+// file. Each top level expression is only built once it's asked for, as
+// nodes in the arena that can be visited like the parser's. Like the parser's,
+// they don't refer to earlier top level expressions. String literals view the
+// data, which must outlive the nodes. Symbols are interned the first time
+// they're used, which copies any spelling the process hasn't seen before into
+// the symbol table.
+class ASTReader : public parse::IParser {
+public:
+  ASTReader(std::string_view Data, ASTArena &);
+  virtual ~ASTReader() = default;
+
+  // IParser impl.
+  IAST *parseTopLevelExpr() override;
+
+private:
+  struct Header;
+  struct NodeEntry;
+  using Word = llvm::support::ulittle32_t;
+
+  IAST *buildNode(uint32_t Index);
+  IAST *getNode(uint32_t Index, uint32_t Parent, bool Optional = false);
+  bool isFunction(uint32_t Index) const;
+  ASTList getList(uint32_t First, uint32_t Count, uint32_t Parent);
+  Symbol getSymbol(uint32_t Index);
+  std::string_view getString(uint32_t Offset, uint32_t Size) const;
+
+  ASTArena &Arena;
+  const Header *FileHeader;
+  const NodeEntry *Nodes;
+  const Word *Children;
+  const Word *Args;
+  const Word *TopLevel;
+  const Word *Symbols;
+  const char *Strings;
+  std::vector<IAST *> Built;
+  std::vector<std::optional<Symbol>> Interned;
+  std::vector<IAST *> Scratch;
+  // Nodes of the top level expression being built start at FirstNode.
+  uint32_t FirstNode = 0;
+  uint32_t NextNode = 0;
+  uint32_t NextTopLevel = 0;
+};
+
+} // namespace fantac::ast
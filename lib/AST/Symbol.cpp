@@ -0,0 +1,91 @@
+#include "Symbol.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantac::ast {
+
+namespace {
+
+// Names are stored in chunks that never move, found through a fixed
+// directory big enough for every 32-bit id, so a symbol's name can be read
+// without a lock.
+constexpr uint32_t ChunkBits = 12;
+constexpr uint32_t ChunkSize = 1u << ChunkBits;
+constexpr uint32_t NumChunks = 1u << (32 - ChunkBits);
+
+// Shared by every compilation thread. Lookups take a shared lock and only
+// adding a new name takes the exclusive one.
+struct SymbolTable {
+  std::shared_mutex Mutex;
+  // Deque so that the views held by Ids and the chunks stay valid as names
+  // are added.
+  std::deque<std::string> Names;
+  std::unordered_map<std::string_view, uint32_t> Ids;
+  std::vector<std::unique_ptr<std::string_view[]>> Chunks;
+};
+
+// Kept out of the table so that it's zero initialised rather than
+// constructed, and only the pages in use are ever touched. A chunk is
+// published before any of its ids are handed out.
+std::atomic<const std::string_view *> ChunkDirectory[NumChunks];
+
+SymbolTable &getSymbolTable() {
+  static SymbolTable Table;
+  return Table;
+}
+
+// Each thread remembers the names it's interned, so the parser only touches
+// the shared table the first time it sees a spelling. The views point into
+// the table, which outlives every thread.
+thread_local std::unordered_map<std::string_view, uint32_t> LocalIds;
+
+} // namespace
+
+Symbol Symbol::intern(std::string_view Name) {
+  const auto Local = LocalIds.find(Name);
+  if (Local != LocalIds.end())
+    return Symbol(Local->second);
+
+  auto &Table = getSymbolTable();
+  {
+    std::shared_lock<std::shared_mutex> Lock(Table.Mutex);
+    const auto Iter = Table.Ids.find(Name);
+    if (Iter != Table.Ids.end()) {
+      LocalIds.emplace(Iter->first, Iter->second);
+      return Symbol(Iter->second);
+    }
+  }
+
+  // Another thread may have added the name since the lookup above.
+  std::unique_lock<std::shared_mutex> Lock(Table.Mutex);
+  auto Iter = Table.Ids.find(Name);
+  if (Iter == Table.Ids.end()) {
+    const auto Id = static_cast<uint32_t>(Table.Names.size());
+    const std::string_view Stored = Table.Names.emplace_back(Name);
+    if (Id % ChunkSize == 0) {
+      Table.Chunks.push_back(std::make_unique<std::string_view[]>(ChunkSize));
+      ChunkDirectory[Id >> ChunkBits].store(Table.Chunks.back().get(),
+                                            std::memory_order_release);
+    }
+    Table.Chunks.back()[Id % ChunkSize] = Stored;
+    Iter = Table.Ids.emplace(Stored, Id).first;
+  }
+  LocalIds.emplace(Iter->first, Iter->second);
+  return Symbol(Iter->second);
+}
+
+std::string_view Symbol::str() const {
+  // Whoever handed out the id saw its name stored, so no lock is needed.
+  const auto *Chunk =
+      ChunkDirectory[Id >> ChunkBits].load(std::memory_order_acquire);
+  return Chunk[Id % ChunkSize];
+}
+
+} // namespace fantac::ast
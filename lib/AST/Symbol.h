@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace fantac::ast {
+
+// Handle to an identifier in the global symbol table. Every spelling is
+// interned once so names can be compared and hashed as integers. The table is
+// safe to use from several compilation threads at once, and reading a
+// symbol's name never takes a lock.
+class Symbol {
+public:
+  static Symbol intern(std::string_view Name);
+
+  std::string_view str() const;
+  uint32_t id() const { return Id; }
+
+  bool operator==(Symbol Other) const { return Id == Other.Id; }
+  bool operator!=(Symbol Other) const { return Id != Other.Id; }
+
+private:
+  explicit Symbol(uint32_t Id) : Id(Id) {}
+
+  uint32_t Id;
+};
+
+} // namespace fantac::ast
@@ -1,18 +1,34 @@
 #include "IRGenerator.h"
 
 #include <AST/AST.h>
+#include <Support/Statistics.h>
 
 #include <fmt/format.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/TimeProfiler.h>
 
 namespace fantac::codegen {
 
-IRGenerator::IRGenerator()
-    : Builder(Context), Module("FantaC", Context), LoadVariables(true) {}
+namespace {
 
-IRGenerator::~IRGenerator() { Module.print(llvm::errs(), nullptr); }
+stats::Counter VariableLookups("codegen", "Lookups in NamedVariables");
+stats::Counter VariableInserts("codegen", "Insertions into NamedVariables");
 
-void IRGenerator::visit(ast::FunctionDecl &AST) { visitAndAssign(AST); }
+llvm::StringRef toStringRef(ast::Symbol Name) {
+  const auto Str = Name.str();
+  return llvm::StringRef(Str.data(), Str.size());
+}
+
+} // namespace
+
+IRGenerator::IRGenerator(llvm::LLVMContext &Context)
+    : Context(Context), Builder(Context),
+      Module(std::make_unique<llvm::Module>("FantaC", Context)),
+      LoadVariables(true) {}
+
+// Declarations have no value. Leaving the node alone means generators on
+// different threads can share prototypes.
+void IRGenerator::visit(ast::FunctionDecl &AST) { visitImpl(AST); }
 
 void IRGenerator::visit(ast::FunctionDef &AST) { visitAndAssign(AST); }
 
@@ -50,7 +66,20 @@ template <typename T> void IRGenerator::visitAndAssign(T &AST) {
   AST.LLVMValue = visitImpl(AST);
 }
 
+void IRGenerator::addPrototype(ast::FunctionDecl &AST) {
+  Prototypes.try_emplace(AST.Name.id(), &AST);
+}
+
 llvm::Value *IRGenerator::visitImpl(ast::FunctionDecl &AST) {
+  // Declare any unused prototype first so that this is checked against it.
+  const auto Prototype = Prototypes.find(AST.Name.id());
+  if (Prototype != Prototypes.end()) {
+    auto *Decl = Prototype->second;
+    Prototypes.erase(Prototype);
+    if (Decl != &AST)
+      Decl->accept(*this);
+  }
+
   std::vector<llvm::Type *> ArgTypes;
   for (const auto &Arg : AST.Args)
     ArgTypes.push_back(cTypeToLLVMType(Arg.second));
@@ -58,37 +87,46 @@ llvm::Value *IRGenerator::visitImpl(ast::FunctionDecl &AST) {
   llvm::Type *ReturnType = cTypeToLLVMType(AST.Return);
   llvm::FunctionType *FT = llvm::FunctionType::get(ReturnType, ArgTypes, false);
 
+  // Redeclarations refer to the same function.
+  const auto Existing = Functions.find(AST.Name.id());
+  if (Existing != Functions.end()) {
+    if (Existing->second->getFunctionType() != FT)
+      throw CodeGenException(
+          fmt::format("Conflicting declaration of {}.", AST.Name.str()));
+
+    return nullptr;
+  }
+
   llvm::Function *F = llvm::Function::Create(
-      FT, llvm::Function::ExternalLinkage, AST.Name, &Module);
+      FT, llvm::Function::ExternalLinkage, toStringRef(AST.Name), Module.get());
 
   unsigned int Index = 0;
   for (auto &Arg : F->args())
-    Arg.setName(AST.Args[Index++].first);
+    Arg.setName(toStringRef(AST.Args[Index++].first));
 
-  Functions.emplace(AST.Name, F);
+  Functions.try_emplace(AST.Name.id(), F);
   return nullptr;
 }
 
 llvm::Value *IRGenerator::visitImpl(ast::FunctionDef &AST) {
-  const auto &Name = AST.Decl->Name;
-
-  auto Iter = Functions.find(Name);
-  if (Iter == Functions.end()) {
-    AST.Decl->accept(*this);
-    Iter = Functions.find(Name);
-  }
+  const auto Name = AST.Decl->Name;
+  llvm::TimeTraceScope Scope("IRGen", toStringRef(Name));
 
-  llvm::Function *F = Iter->second;
+  // Declares the function, or checks it matches an earlier declaration.
+  AST.Decl->accept(*this);
+  llvm::Function *F = Functions.find(Name.id())->second;
   llvm::BasicBlock *BB = llvm::BasicBlock::Create(Context, "entry", F);
   Builder.SetInsertPoint(BB);
 
   NamedVariables.clear();
+  unsigned int Index = 0;
   for (auto &Arg : F->args()) {
     llvm::AllocaInst *Alloca =
         createEntryBlockAlloca(F, Arg.getName(), Arg.getType());
 
     Builder.CreateStore(&Arg, Alloca);
-    NamedVariables.emplace(Arg.getName(), Alloca);
+    VariableInserts.add();
+    NamedVariables.try_emplace(AST.Decl->Args[Index++].first.id(), Alloca);
   }
 
   for (const auto &Instruction : AST.Body)
@@ -111,9 +149,11 @@ llvm::Value *IRGenerator::visitImpl(ast::VariableDecl &AST) {
     }
   }();
 
-  auto *Alloca = createEntryBlockAlloca(F, AST.Name, VariableType);
+  auto *Alloca =
+      createEntryBlockAlloca(F, toStringRef(AST.Name), VariableType);
   Builder.CreateStore(InitialValue, Alloca);
-  NamedVariables.emplace(AST.Name, Alloca);
+  VariableInserts.add();
+  NamedVariables.try_emplace(AST.Name.id(), Alloca);
   return nullptr;
 }
 
@@ -243,15 +283,18 @@ llvm::Value *IRGenerator::visitImpl(ast::StringLiteral &AST) {
 }
 
 llvm::Value *IRGenerator::visitImpl(ast::VariableRef &AST) {
-  const auto VarIter = NamedVariables.find(AST.Name);
+  VariableLookups.add();
+  const auto VarIter = NamedVariables.find(AST.Name.id());
   if (VarIter == NamedVariables.end())
-    throw CodeGenException(
-        fmt::format("Reference to non-existent variable name: {}.", AST.Name));
+    throw CodeGenException(fmt::format(
+        "Reference to non-existent variable name: {}.", AST.Name.str()));
 
+  llvm::AllocaInst *Alloca = VarIter->second;
   if (LoadVariables)
-    return Builder.CreateLoad(VarIter->second, AST.Name);
+    return Builder.CreateLoad(Alloca->getAllocatedType(), Alloca,
+                              toStringRef(AST.Name));
 
-  return VarIter->second;
+  return Alloca;
 }
 
 llvm::Value *IRGenerator::visitImpl(ast::WhileLoop &AST) {
@@ -288,12 +331,11 @@ llvm::Value *IRGenerator::visitImpl(ast::MemberAccess &AST) {
 }
 
 llvm::Value *IRGenerator::visitImpl(ast::FunctionCall &AST) {
-  const auto FunctionIter = Functions.find(AST.Name);
-  if (FunctionIter == Functions.end())
+  llvm::Function *F = getFunction(AST.Name);
+  if (!F)
     throw CodeGenException(fmt::format(
-        "Found function call to unknown function name: {}.", AST.Name));
+        "Found function call to unknown function name: {}.", AST.Name.str()));
 
-  llvm::Function *F = FunctionIter->second;
   if (F->arg_size() != AST.Args.size())
     throw CodeGenException(fmt::format(
         "Incorrect number of arguments passed. Expected {} but got {}.",
@@ -318,8 +360,21 @@ llvm::Value *IRGenerator::visitImpl(ast::Return &AST) {
   return nullptr;
 }
 
+llvm::Function *IRGenerator::getFunction(ast::Symbol Name) {
+  const auto Iter = Functions.find(Name.id());
+  if (Iter != Functions.end())
+    return Iter->second;
+
+  const auto Prototype = Prototypes.find(Name.id());
+  if (Prototype == Prototypes.end())
+    return nullptr;
+
+  Prototype->second->accept(*this);
+  return Functions.find(Name.id())->second;
+}
+
 llvm::AllocaInst *IRGenerator::createEntryBlockAlloca(
-    llvm::Function *F, const std::string &VariableName, llvm::Type *Type) {
+    llvm::Function *F, llvm::StringRef VariableName, llvm::Type *Type) {
   llvm::IRBuilder<> B(&F->getEntryBlock(), F->getEntryBlock().begin());
 
   return B.CreateAlloca(Type, nullptr, VariableName);
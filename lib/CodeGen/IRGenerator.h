@@ -1,7 +1,9 @@
 #pragma once
 
 #include <AST/ASTInterfaces.h>
+#include <AST/Symbol.h>
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -24,8 +26,18 @@ public:
 
 class IRGenerator : public ast::IASTVisitor {
 public:
-  IRGenerator();
-  virtual ~IRGenerator();
+  explicit IRGenerator(llvm::LLVMContext &);
+  virtual ~IRGenerator() = default;
+
+  llvm::Module &getModule() { return *Module; }
+  // Hands the module over to the caller, such as a JIT. The generator can't be
+  // used afterwards.
+  std::unique_ptr<llvm::Module> takeModule() { return std::move(Module); }
+  // Makes a function known without declaring it in the module. It's only
+  // declared once it's called, defined or declared again, so unused
+  // prototypes, like most of a prelude's, cost nothing. Prototypes are only
+  // read, so generators on different threads can share them.
+  void addPrototype(ast::FunctionDecl &);
 
   // IASTVisitor impl.
   void visit(ast::FunctionDecl &) override;
@@ -65,8 +77,9 @@ private:
   llvm::Value *visitImpl(ast::MemberAccess &);
   llvm::Value *visitImpl(ast::FunctionCall &);
   llvm::Value *visitImpl(ast::Return &);
-  llvm::AllocaInst *createEntryBlockAlloca(llvm::Function *,
-                                           const std::string &, llvm::Type *);
+  llvm::Function *getFunction(ast::Symbol Name);
+  llvm::AllocaInst *createEntryBlockAlloca(llvm::Function *, llvm::StringRef,
+                                           llvm::Type *);
   llvm::Type *cTypeToLLVMType(ast::CType);
   llvm::Value *greaterThan(llvm::Value *, llvm::Value *);
   llvm::Value *greaterThanEq(llvm::Value *, llvm::Value *);
@@ -74,11 +87,13 @@ private:
   llvm::Value *assign(llvm::Value *, llvm::Value *);
   llvm::Value *add(llvm::Value *, llvm::Value *);
 
-  llvm::LLVMContext Context;
+  llvm::LLVMContext &Context;
   llvm::IRBuilder<> Builder;
-  llvm::Module Module;
-  std::map<std::string, llvm::AllocaInst *> NamedVariables;
-  std::map<std::string, llvm::Function *> Functions;
+  std::unique_ptr<llvm::Module> Module;
+  // All keyed by ast::Symbol id.
+  llvm::DenseMap<uint32_t, llvm::AllocaInst *> NamedVariables;
+  llvm::DenseMap<uint32_t, llvm::Function *> Functions;
+  llvm::DenseMap<uint32_t, ast::FunctionDecl *> Prototypes;
   bool LoadVariables;
 };
 
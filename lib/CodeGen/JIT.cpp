@@ -0,0 +1,165 @@
+#include "JIT.h"
+#include "IRGenerator.h"
+#include "Optimizer.h"
+#include "TargetEmitter.h"
+
+#include <fmt/format.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstdio>
+
+namespace fantac::codegen {
+
+namespace {
+
+// Runtime for the helpers that test programs declare. These live in
+// test_main.c when linking natively.
+int putchari(int X) {
+  std::fputc(static_cast<char>(X), stdout);
+  return 0;
+}
+
+int printi(int X) {
+  std::fprintf(stdout, "%d\n", X);
+  return 0;
+}
+
+float printfl(float X) {
+  std::fprintf(stdout, "%f\n", X);
+  return 0.0;
+}
+
+template <typename T> T unwrap(llvm::Expected<T> Value) {
+  if (!Value)
+    throw CodeGenException(
+        fmt::format("JIT error: {}.", llvm::toString(Value.takeError())));
+
+  return std::move(*Value);
+}
+
+void unwrap(llvm::Error Err) {
+  if (Err)
+    throw CodeGenException(
+        fmt::format("JIT error: {}.", llvm::toString(std::move(Err))));
+}
+
+} // namespace
+
+JIT::JIT(unsigned int OptLevel, bool Lazy) : Lazy(Lazy) {
+  initializeNativeTarget();
+
+  auto Builder = unwrap(llvm::orc::JITTargetMachineBuilder::detectHost());
+  Builder.setCodeGenOptLevel(toCodeGenOptLevel(OptLevel));
+  Machine = unwrap(Builder.createTargetMachine());
+  if (Lazy)
+    Engine = unwrap(llvm::orc::LLLazyJITBuilder()
+                        .setJITTargetMachineBuilder(std::move(Builder))
+                        .create());
+  else
+    Engine = unwrap(llvm::orc::LLJITBuilder()
+                        .setJITTargetMachineBuilder(std::move(Builder))
+                        .create());
+
+  // The transform layer sits below the compile on demand layer, so in lazy
+  // mode this only sees the functions that are about to be compiled.
+  Engine->getIRTransformLayer().setTransform(
+      [OptLevel, Machine = Machine.get()](
+          llvm::orc::ThreadSafeModule TSM,
+          llvm::orc::MaterializationResponsibility &) {
+        TSM.withModuleDo([OptLevel, Machine](llvm::Module &Module) {
+          optimize(Module, OptLevel, Machine);
+        });
+        return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(TSM));
+      });
+
+  auto &MainDylib = Engine->getMainJITDylib();
+  MainDylib.addGenerator(unwrap(
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          Engine->getDataLayout().getGlobalPrefix())));
+
+  llvm::orc::MangleAndInterner Mangle(Engine->getExecutionSession(),
+                                      Engine->getDataLayout());
+  const auto Flags = llvm::JITSymbolFlags::Exported;
+  unwrap(MainDylib.define(llvm::orc::absoluteSymbols(
+      {{Mangle("putchari"),
+        {llvm::pointerToJITTargetAddress(&putchari), Flags}},
+       {Mangle("printi"), {llvm::pointerToJITTargetAddress(&printi), Flags}},
+       {Mangle("printfl"),
+        {llvm::pointerToJITTargetAddress(&printfl), Flags}}})));
+}
+
+JIT::~JIT() = default;
+
+void JIT::configure(llvm::Module &Module) {
+  Module.setTargetTriple(Engine->getTargetTriple().str());
+  Module.setDataLayout(Engine->getDataLayout());
+}
+
+void JIT::addModule(std::unique_ptr<llvm::Module> Module,
+                    std::unique_ptr<llvm::LLVMContext> Context) {
+  // Remember the signatures now. The module is gone once it's compiled.
+  for (const auto &F : *Module) {
+    if (F.isDeclaration() || F.arg_size() != 0)
+      continue;
+
+    auto *ReturnType = F.getReturnType();
+    if (ReturnType->isVoidTy())
+      EntryPoints[F.getName()] = ReturnKind::RK_Void;
+    else if (ReturnType->isIntegerTy(8))
+      EntryPoints[F.getName()] = ReturnKind::RK_Int8;
+    else if (ReturnType->isIntegerTy(16))
+      EntryPoints[F.getName()] = ReturnKind::RK_Int16;
+    else if (ReturnType->isIntegerTy(32))
+      EntryPoints[F.getName()] = ReturnKind::RK_Int32;
+    else if (ReturnType->isIntegerTy(64))
+      EntryPoints[F.getName()] = ReturnKind::RK_Int64;
+    else if (ReturnType->isFloatTy())
+      EntryPoints[F.getName()] = ReturnKind::RK_Float;
+    else if (ReturnType->isDoubleTy())
+      EntryPoints[F.getName()] = ReturnKind::RK_Double;
+  }
+
+  llvm::orc::ThreadSafeModule TSM(std::move(Module), std::move(Context));
+  if (Lazy)
+    unwrap(static_cast<llvm::orc::LLLazyJIT &>(*Engine).addLazyIRModule(
+        std::move(TSM)));
+  else
+    unwrap(Engine->addIRModule(std::move(TSM)));
+}
+
+int JIT::run(const std::string &EntryName) {
+  const auto Entry = EntryPoints.find(EntryName);
+  if (Entry == EntryPoints.end())
+    throw CodeGenException(fmt::format(
+        "No definition of {} taking no arguments to run.", EntryName));
+
+  const auto Address = unwrap(Engine->lookup(EntryName)).getAddress();
+  switch (Entry->second) {
+  case ReturnKind::RK_Void:
+    llvm::jitTargetAddressToFunction<void (*)()>(Address)();
+    return 0;
+  case ReturnKind::RK_Int8:
+    return llvm::jitTargetAddressToFunction<char (*)()>(Address)();
+  case ReturnKind::RK_Int16:
+    return llvm::jitTargetAddressToFunction<short (*)()>(Address)();
+  case ReturnKind::RK_Int32:
+    return llvm::jitTargetAddressToFunction<int (*)()>(Address)();
+  case ReturnKind::RK_Int64:
+    return static_cast<int>(
+        llvm::jitTargetAddressToFunction<long long (*)()>(Address)());
+  case ReturnKind::RK_Float:
+    llvm::jitTargetAddressToFunction<float (*)()>(Address)();
+    return 0;
+  case ReturnKind::RK_Double:
+    llvm::jitTargetAddressToFunction<double (*)()>(Address)();
+    return 0;
+  }
+
+  return 0;
+}
+
+} // namespace fantac::codegen
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+
+class LLVMContext;
+class Module;
+class TargetMachine;
+
+namespace orc {
+
+class LLJIT;
+
+} // namespace orc
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+// Compiles modules into the running process with LLVM ORC so they can be
+// called straight away. External declarations resolve against the host
+// process along with a small runtime for the helpers that test programs use.
+//
+// When lazy, each function is only optimised and compiled the first time it's
+// called, so startup time scales with the code that actually runs rather than
+// the size of the module.
+class JIT {
+public:
+  JIT(unsigned int OptLevel, bool Lazy);
+  ~JIT();
+
+  // Sets the module's target triple and data layout.
+  void configure(llvm::Module &);
+  // Takes ownership of the module and the context it was created in. The
+  // module is optimised as it's compiled.
+  void addModule(std::unique_ptr<llvm::Module>,
+                 std::unique_ptr<llvm::LLVMContext>);
+  // Calls a function taking no arguments. Returns its result if it's an
+  // integer, otherwise zero.
+  int run(const std::string &EntryName);
+
+private:
+  enum class ReturnKind {
+    RK_Void,
+    RK_Int8,
+    RK_Int16,
+    RK_Int32,
+    RK_Int64,
+    RK_Float,
+    RK_Double,
+  };
+
+  // Only used to tune the optimisation pipeline, which runs on the thread
+  // that compiles for the JIT.
+  std::unique_ptr<llvm::TargetMachine> Machine;
+  std::unique_ptr<llvm::orc::LLJIT> Engine;
+  bool Lazy;
+  // Functions that can be used as entry points, by name.
+  llvm::StringMap<ReturnKind> EntryPoints;
+};
+
+} // namespace fantac::codegen
@@ -0,0 +1,88 @@
+#include "Optimizer.h"
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Passes/PassBuilder.h>
+
+#include <cassert>
+
+namespace fantac::codegen {
+
+namespace {
+
+llvm::OptimizationLevel toLLVMOptLevel(unsigned int OptLevel) {
+  switch (OptLevel) {
+  case 1:
+    return llvm::OptimizationLevel::O1;
+  case 2:
+    return llvm::OptimizationLevel::O2;
+  default:
+    return llvm::OptimizationLevel::O3;
+  }
+}
+
+} // namespace
+
+void optimize(llvm::Module &Module, unsigned int OptLevel,
+              llvm::TargetMachine *Machine) {
+  assert(OptLevel <= 3);
+  if (OptLevel == 0)
+    return;
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+
+  llvm::PassBuilder PB(Machine);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  // Promotes the entry block allocas to registers (mem2reg), then runs the
+  // usual instcombine, GVN, loop and inlining passes for the level.
+  auto MPM = PB.buildPerModuleDefaultPipeline(toLLVMOptLevel(OptLevel));
+  MPM.run(Module, MAM);
+}
+
+struct FunctionOptimizer::Pipeline {
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::FunctionPassManager FPM;
+};
+
+FunctionOptimizer::FunctionOptimizer(unsigned int OptLevel,
+                                     llvm::TargetMachine *Machine) {
+  assert(OptLevel <= 3);
+  if (OptLevel == 0)
+    return;
+
+  Passes = std::make_unique<Pipeline>();
+  llvm::PassBuilder PB(Machine);
+  PB.registerModuleAnalyses(Passes->MAM);
+  PB.registerCGSCCAnalyses(Passes->CGAM);
+  PB.registerFunctionAnalyses(Passes->FAM);
+  PB.registerLoopAnalyses(Passes->LAM);
+  PB.crossRegisterProxies(Passes->LAM, Passes->FAM, Passes->CGAM,
+                          Passes->MAM);
+
+  Passes->FPM = PB.buildFunctionSimplificationPipeline(
+      toLLVMOptLevel(OptLevel), llvm::ThinOrFullLTOPhase::None);
+}
+
+FunctionOptimizer::~FunctionOptimizer() = default;
+
+void FunctionOptimizer::optimize(llvm::Function &F) {
+  if (!Passes || F.isDeclaration())
+    return;
+
+  Passes->FPM.run(F, Passes->FAM);
+  // Results for other functions would outlive them once they're freed.
+  Passes->FAM.clear();
+}
+
+} // namespace fantac::codegen
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+
+namespace llvm {
+
+class Function;
+class Module;
+class TargetMachine;
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+// Runs LLVM's default per-module pipeline for the given level (0 to 3). Level
+// 0 leaves the module untouched. Given the machine the module will be compiled
+// for, the vectoriser, unroller, inliner and other passes weigh their
+// transforms with its cost model rather than a generic one.
+void optimize(llvm::Module &, unsigned int OptLevel,
+              llvm::TargetMachine *Machine);
+
+// Runs LLVM's per-function simplification pipeline for the given level on one
+// function at a time, for when the rest of the module isn't available.
+// Nothing is inlined. The pipeline is built once and reused for every
+// function.
+class FunctionOptimizer {
+public:
+  FunctionOptimizer(unsigned int OptLevel, llvm::TargetMachine *Machine);
+  ~FunctionOptimizer();
+
+  void optimize(llvm::Function &);
+
+private:
+  struct Pipeline;
+
+  std::unique_ptr<Pipeline> Passes;
+};
+
+} // namespace fantac::codegen
@@ -0,0 +1,99 @@
+#include "TargetEmitter.h"
+#include "IRGenerator.h"
+
+#include <fmt/format.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <mutex>
+
+namespace fantac::codegen {
+
+void initializeNativeTarget() {
+  static std::once_flag InitializeOnce;
+  std::call_once(InitializeOnce, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+}
+
+llvm::CodeGenOpt::Level toCodeGenOptLevel(unsigned int OptLevel) {
+  switch (OptLevel) {
+  case 0:
+    return llvm::CodeGenOpt::None;
+  case 1:
+    return llvm::CodeGenOpt::Less;
+  case 2:
+    return llvm::CodeGenOpt::Default;
+  default:
+    return llvm::CodeGenOpt::Aggressive;
+  }
+}
+
+TargetEmitter::TargetEmitter(unsigned int OptLevel) {
+  initializeNativeTarget();
+
+  const auto Triple = llvm::sys::getDefaultTargetTriple();
+  std::string Error;
+  const auto *Target = llvm::TargetRegistry::lookupTarget(Triple, Error);
+  if (!Target)
+    throw CodeGenException(
+        fmt::format("Unable to find target for {}: {}.", Triple, Error));
+
+  // Position independent so the output links into PIE executables.
+  Machine.reset(Target->createTargetMachine(
+      Triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_,
+      llvm::None, toCodeGenOptLevel(OptLevel)));
+  if (!Machine)
+    throw CodeGenException(
+        fmt::format("Unable to create target machine for {}.", Triple));
+}
+
+TargetEmitter::~TargetEmitter() = default;
+
+void TargetEmitter::configure(llvm::Module &Module) {
+  Module.setTargetTriple(Machine->getTargetTriple().str());
+  Module.setDataLayout(Machine->createDataLayout());
+}
+
+void TargetEmitter::emitAssembly(llvm::Module &Module,
+                                 llvm::raw_fd_ostream &Out) {
+  emit(Module, Out, true);
+}
+
+void TargetEmitter::emitObject(llvm::Module &Module,
+                               llvm::raw_fd_ostream &Out) {
+  emit(Module, Out, false);
+}
+
+void TargetEmitter::emit(llvm::Module &Module, llvm::raw_fd_ostream &Out,
+                         bool Assembly) {
+  // Object emission seeks back to patch headers, which pipes can't do.
+  std::unique_ptr<llvm::buffer_ostream> Buffer;
+  llvm::raw_pwrite_stream *OS = &Out;
+  if (!Out.supportsSeeking()) {
+    Buffer = std::make_unique<llvm::buffer_ostream>(Out);
+    OS = Buffer.get();
+  }
+
+  llvm::legacy::PassManager PM;
+  addPassesToEmit(PM, *OS, Assembly);
+  PM.run(Module);
+}
+
+void TargetEmitter::addPassesToEmit(llvm::legacy::PassManager &PM,
+                                    llvm::raw_pwrite_stream &Out,
+                                    bool Assembly) {
+  if (Machine->addPassesToEmitFile(PM, Out, nullptr,
+                                   Assembly ? llvm::CGFT_AssemblyFile
+                                            : llvm::CGFT_ObjectFile))
+    throw CodeGenException("Target is unable to emit a file of this type.");
+}
+
+} // namespace fantac::codegen
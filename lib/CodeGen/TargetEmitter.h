@@ -0,0 +1,56 @@
+#pragma once
+
+#include <llvm/Support/CodeGen.h>
+
+#include <memory>
+
+namespace llvm {
+
+class Module;
+class TargetMachine;
+class raw_fd_ostream;
+class raw_pwrite_stream;
+
+namespace legacy {
+
+class PassManager;
+
+} // namespace legacy
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+// Registers the host target with LLVM. Safe to call from any thread and more
+// than once.
+void initializeNativeTarget();
+
+llvm::CodeGenOpt::Level toCodeGenOptLevel(unsigned int OptLevel);
+
+// Lowers modules to native assembly or object code for the host through an
+// LLVM TargetMachine. Not thread safe, so each compilation thread should
+// create its own.
+class TargetEmitter {
+public:
+  explicit TargetEmitter(unsigned int OptLevel);
+  ~TargetEmitter();
+
+  // Sets the module's target triple and data layout. Do this before
+  // optimising so the passes can make use of them.
+  void configure(llvm::Module &);
+  // For tuning the optimisation pipeline to the target.
+  llvm::TargetMachine &getTargetMachine() { return *Machine; }
+  void emitAssembly(llvm::Module &, llvm::raw_fd_ostream &);
+  void emitObject(llvm::Module &, llvm::raw_fd_ostream &);
+  // Adds the code generation passes writing assembly or object code to a
+  // seekable stream, for callers that drive the pass manager themselves.
+  void addPassesToEmit(llvm::legacy::PassManager &, llvm::raw_pwrite_stream &,
+                       bool Assembly);
+
+private:
+  void emit(llvm::Module &, llvm::raw_fd_ostream &, bool Assembly);
+
+  std::unique_ptr<llvm::TargetMachine> Machine;
+};
+
+} // namespace fantac::codegen
@@ -1,41 +1,598 @@
 #include "FantaC.h"
+#include "FunctionCache.h"
+#include "FunctionStreamer.h"
+#include "HeaderCache.h"
+#include "NativeStreamer.h"
+#include "ParallelGenerator.h"
+#include "Pipeline.h"
+#include "Prelude.h"
+#include "SourceBuffer.h"
+#include "TimeReport.h"
+#include "Trace.h"
 
+#include <AST/ASTArena.h>
+#include <AST/ASTSerialization.h>
 #include <CodeGen/IRGenerator.h>
+#include <CodeGen/JIT.h>
+#include <CodeGen/Optimizer.h>
+#include <CodeGen/TargetEmitter.h>
 #include <Parse/Lexer.h>
 #include <Parse/Parser.h>
+#include <Parse/Preprocessor.h>
+#include <Support/Statistics.h>
 
 #include <fmt/format.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_ostream.h>
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
 
 namespace fantac {
 
-void run(const std::string &FileName) {
-  std::ifstream File(FileName);
-  std::string Source((std::istreambuf_iterator<char>(File)),
-                     std::istreambuf_iterator<char>());
+namespace {
 
-  // Construct parsing components.
-  parse::Lexer L(&*Source.begin(), &*(Source.end() - 1));
-  parse::Parser P(L);
+const char *outputExtension(EmitKind Kind) {
+  switch (Kind) {
+  case EmitKind::EK_LLVMIR:
+    return "ll";
+  case EmitKind::EK_Bitcode:
+    return "bc";
+  case EmitKind::EK_Assembly:
+    return "s";
+  case EmitKind::EK_Object:
+    return "o";
+  case EmitKind::EK_Prelude:
+    return "pch";
+  case EmitKind::EK_AST:
+    return "ast";
+  }
 
-  // Construct LLVM code generator.
-  codegen::IRGenerator IR;
+  return "out";
+}
 
-  try {
-    // Parse into AST and generate LLVM IR.
-    while (auto AST = P.parseTopLevelExpr()) {
+// Works out where the output for a source file goes. An empty name means
+// stderr, which is where a lone module's IR has always been printed.
+std::string outputFileName(const std::string &FileName, const Options &Opts) {
+  if (!Opts.OutputFileName.empty())
+    return Opts.OutputFileName;
+
+  const bool IsIR = Opts.Emit == EmitKind::EK_LLVMIR;
+  if (IsIR && (Opts.FileNames.size() == 1 || FileName == "-"))
+    return std::string();
+
+  // Binary output for stdin goes to stdout.
+  if (FileName == "-")
+    return FileName;
+
+  llvm::SmallString<128> Path(FileName);
+  llvm::sys::path::replace_extension(Path, outputExtension(Opts.Emit));
+  return std::string(Path.str());
+}
+
+// Serialised ASTs are read as they are instead of being preprocessed and
+// parsed.
+bool isASTFile(const std::string &FileName) {
+  return llvm::sys::path::extension(FileName) == ".ast";
+}
+
+// Opens an output file, or stdout for "-". Returns null on failure.
+std::unique_ptr<llvm::raw_fd_ostream>
+openOutput(const std::string &OutputFileName, bool IsText) {
+  std::error_code EC;
+  auto Out = std::make_unique<llvm::raw_fd_ostream>(
+      OutputFileName, EC,
+      IsText ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+  if (EC) {
+    fmt::print("Unable to open output file {}: {}.\n", OutputFileName,
+               EC.message());
+    return nullptr;
+  }
+
+  return Out;
+}
+
+// Like openOutput, but the file is removed again unless it's kept, so a
+// failed compile doesn't leave a partial output behind.
+std::unique_ptr<llvm::ToolOutputFile>
+openToolOutput(const std::string &OutputFileName, bool IsText) {
+  std::error_code EC;
+  auto Out = std::make_unique<llvm::ToolOutputFile>(
+      OutputFileName, EC,
+      IsText ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+  if (EC) {
+    fmt::print("Unable to open output file {}: {}.\n", OutputFileName,
+               EC.message());
+    return nullptr;
+  }
+
+  return Out;
+}
+
+// Describes everything besides the source that affects the generated code.
+std::string cacheFlags(const llvm::Module &Module, const Options &Opts) {
+  return fmt::format("LLVM {} -O{} {} {}", LLVM_VERSION_STRING, Opts.OptLevel,
+                     Module.getTargetTriple(), Module.getDataLayoutStr());
+}
+
+// State shared by every translation unit compiled in this process.
+struct Session {
+  explicit Session(const Options &Opts) : Headers(Opts.IncludeDirectories) {
+    if (Opts.TimeReportFormat != ReportFormat::RF_None)
+      Report = std::make_unique<TimeReport>();
+  }
+
+  // Loads anything named by the options. Returns false on failure.
+  bool initialize(const Options &Opts) {
+    if (Opts.PreludeFileName.empty())
+      return true;
+
+    try {
+      PCH = std::make_unique<Prelude>(Opts.PreludeFileName);
+    } catch (const PreludeException &Error) {
+      fmt::print("Caught PreludeException: \"{}\". Terminating "
+                 "compilation.\n",
+                 Error.what());
+      return false;
+    } catch (const parse::ParseException &Error) {
+      fmt::print("Caught ParseException: \"{}\". Terminating "
+                 "compilation.\n",
+                 Error.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  HeaderCache Headers;
+  std::unique_ptr<Prelude> PCH;
+  // Only kept with --time-report.
+  std::unique_ptr<TimeReport> Report;
+};
+
+// Passes each top level expression to the visitor. When the visitor doesn't
+// hold on to nodes, each expression can be freed once it's been visited.
+void visitAll(parse::IParser &P, ast::IASTVisitor &Visitor,
+              ast::ASTArena *Reclaim) {
+  for (;;) {
+    ast::IAST *AST;
+    {
+      PhaseTimer Timer(CompilePhase::CP_Parse);
+      if (!(AST = P.parseTopLevelExpr()))
+        break;
+    }
 #ifndef NDEBUG
-      fmt::print("{};\n\n", AST->toString());
+    fmt::print("{};\n\n", AST->toString());
 #endif
-      AST->accept(IR);
+    {
+      PhaseTimer Timer(CompilePhase::CP_IRGen);
+      AST->accept(Visitor);
     }
-  } catch (const parse::ParseException &Error) {
-    fmt::print("Caught ParseException: \"{}\". Terminating compilation.",
+    if (Reclaim)
+      Reclaim->reset();
+  }
+}
+
+// Preprocesses and parses a single translation unit, passing each top level
+// expression to the visitor. When caching, the cache watches the tokens the
+// parser reads. When writing a prelude, the writer gets the final macros.
+// Serialised ASTs are read straight out of the source buffer instead. When
+// generating in parallel, the functions are generated before the AST goes.
+bool generate(const std::string &FileName, const Options &Opts, Session &S,
+              ast::IASTVisitor &Visitor, FunctionCache *Cache = nullptr,
+              PreludeWriter *Writer = nullptr,
+              ParallelGenerator *Parallel = nullptr) {
+  std::unique_ptr<SourceBuffer> Source;
+  try {
+    PhaseTimer Timer(CompilePhase::CP_Read);
+    Source = std::make_unique<SourceBuffer>(FileName);
+  } catch (const SourceException &Error) {
+    fmt::print("Caught SourceException: \"{}\". Terminating compilation.\n",
                Error.what());
+    return false;
+  }
+
+  // Construct parsing components. The lexer reads straight out of the source
+  // buffer, but needs at least one character. The arena owns every AST node
+  // and is freed in one go once code generation is done.
+  const auto Text = Source->empty()
+                        ? std::string_view("\n")
+                        : std::string_view(Source->begin(), Source->size());
+  ast::ASTArena Arena;
+  parse::Lexer L(Text.data(), Text.data() + Text.size() - 1);
+
+  try {
+    if (isASTFile(FileName)) {
+      ast::ASTReader Reader(Text, Arena);
+      visitAll(Reader, Visitor, Opts.Stream ? &Arena : nullptr);
+    } else {
+      // The translation unit starts out with the prelude's macros. The parser
+      // reads its first token straight away, which may already run
+      // directives.
+      parse::Preprocessor PP(L, FileName, S.Headers);
+      if (S.PCH)
+        S.PCH->define(PP);
+      for (const auto &[Name, Value] : Opts.Defines)
+        PP.define(Name, Value);
+      // Parse into AST and generate LLVM IR. The arena can't be reset under a
+      // pipeline's parser. Pipelines time their lexer on its own thread.
+      if (Opts.Pipeline) {
+        auto P = std::make_unique<Pipeline>(PP, Arena);
+        visitAll(*P, Visitor, nullptr);
+      } else {
+        std::optional<TimedLexer> Timed;
+        if (TimeReport::active())
+          Timed.emplace(PP);
+        parse::ILexer &Input =
+            Timed ? static_cast<parse::ILexer &>(*Timed) : PP;
+        parse::Parser P(Cache ? Cache->track(Input) : Input, Arena);
+        visitAll(P, Visitor, Opts.Stream ? &Arena : nullptr);
+      }
+
+      if (Writer)
+        Writer->finish(PP);
+    }
+
+    // Functions are verified and optimised on the threads generating them.
+    if (Parallel && !Parallel->finish(Opts.OptLevel)) {
+      fmt::print("{}: Generated invalid LLVM IR. Terminating compilation.\n",
+                 FileName);
+      return false;
+    }
+  } catch (const parse::ParseException &Error) {
+    fmt::print("{}: Caught ParseException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  } catch (const codegen::CodeGenException &Error) {
+    fmt::print("{}: Caught CodeGenException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  } catch (const SourceException &Error) {
+    fmt::print("{}: Caught SourceException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  } catch (const PreludeException &Error) {
+    fmt::print("{}: Caught PreludeException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  } catch (const ast::SerializationException &Error) {
+    fmt::print("{}: Caught SerializationException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  }
+
+  return true;
+}
+
+// The optimiser, code generator and bitcode consumers assume well formed IR.
+bool verify(const std::string &FileName, llvm::Module &Module) {
+  PhaseTimer Timer(CompilePhase::CP_Verify);
+  if (llvm::verifyModule(Module, &llvm::outs())) {
+    fmt::print("{}: Generated invalid LLVM IR. Terminating compilation.\n",
+               FileName);
+    return false;
+  }
+
+  return true;
+}
+
+// Compiles a single translation unit. The emitter is only needed when
+// producing native code or optimising, which is tuned to the host.
+bool compile(const std::string &FileName, const std::string &OutputFileName,
+             const Options &Opts, Session &S, llvm::LLVMContext &Context,
+             codegen::TargetEmitter *Emitter) {
+  llvm::TimeTraceScope Scope("Compile", FileName);
+  if (Opts.Emit == EmitKind::EK_Prelude) {
+    if (isASTFile(FileName)) {
+      fmt::print("{}: Cannot emit a prelude from a serialised AST.\n",
+                 FileName);
+      return false;
+    }
+
+    // A new prelude includes everything from the one it was built with.
+    PreludeWriter Writer(OutputFileName);
+    if (S.PCH)
+      for (auto *Decl : S.PCH->getDecls())
+        Writer.visit(*Decl);
+
+    return generate(FileName, Opts, S, Writer, nullptr, &Writer);
+  }
+
+  if (Opts.Emit == EmitKind::EK_AST) {
+    // Prelude prototypes aren't included, so the AST must be compiled with the
+    // same prelude.
+    ast::ASTWriter Writer;
+    if (!generate(FileName, Opts, S, Writer))
+      return false;
+
+    PhaseTimer Timer(CompilePhase::CP_Emit);
+    auto Out = openOutput(OutputFileName, false);
+    if (!Out)
+      return false;
+
+    Writer.write(*Out);
+    return true;
+  }
+
+  // Construct LLVM code generator.
+  codegen::IRGenerator IR(Context);
+  auto &Module = IR.getModule();
+  llvm::TargetMachine *Machine = nullptr;
+  if (Emitter) {
+    Emitter->configure(Module);
+    Machine = &Emitter->getTargetMachine();
+  }
+
+  if (Opts.Stream) {
+    // Streamed output goes to the same place as a whole module's would. It's
+    // written as it's generated, so it's only kept if the compile succeeds.
+    const bool IsNative = Opts.Emit == EmitKind::EK_Assembly ||
+                          Opts.Emit == EmitKind::EK_Object;
+    std::unique_ptr<llvm::ToolOutputFile> File;
+    if (!OutputFileName.empty() &&
+        !(File = openToolOutput(OutputFileName,
+                                Opts.Emit != EmitKind::EK_Object)))
+      return false;
+
+    if (S.PCH)
+      for (auto *Decl : S.PCH->getDecls())
+        IR.addPrototype(*Decl);
+
+    std::unique_ptr<NativeStreamer> Native;
+    std::unique_ptr<FunctionStreamer> Streamer;
+    try {
+      if (IsNative) {
+        Native = std::make_unique<NativeStreamer>(
+            Module, *Emitter, File->os(),
+            Opts.Emit == EmitKind::EK_Assembly);
+        Streamer = std::make_unique<FunctionStreamer>(IR, *Native,
+                                                      Opts.OptLevel, Machine);
+      } else {
+        Streamer = std::make_unique<FunctionStreamer>(
+            IR, File ? File->os() : llvm::errs(), Opts.OptLevel, Machine);
+      }
+
+      if (!generate(FileName, Opts, S, *Streamer))
+        return false;
+
+      Streamer->finish();
+    } catch (const codegen::CodeGenException &Error) {
+      fmt::print("{}: Caught CodeGenException: \"{}\". Terminating "
+                 "compilation.\n",
+                 FileName, Error.what());
+      return false;
+    }
+
+    if (File)
+      File->keep();
+    return true;
+  }
+
+  // Cache keys are made from the tokens of each function, which serialised
+  // ASTs don't have.
+  std::unique_ptr<FunctionCache> Cache;
+  if (!Opts.CacheDirectory.empty() && !isASTFile(FileName))
+    Cache = std::make_unique<FunctionCache>(Opts.CacheDirectory,
+                                            cacheFlags(Module, Opts), IR);
+
+  std::unique_ptr<ParallelGenerator> Parallel;
+  if (Opts.CodeGenJobs > 1 && !Cache)
+    Parallel = std::make_unique<ParallelGenerator>(IR, Opts.CodeGenJobs);
+
+  // Prelude functions are only declared in the module once they're used.
+  if (S.PCH) {
+    for (auto *Decl : S.PCH->getDecls()) {
+      if (Cache)
+        Cache->addPrototype(*Decl);
+      else if (Parallel)
+        Parallel->addPrototype(*Decl);
+      else
+        IR.addPrototype(*Decl);
+    }
+  }
+
+  ast::IASTVisitor &Visitor =
+      Cache      ? static_cast<ast::IASTVisitor &>(*Cache)
+      : Parallel ? static_cast<ast::IASTVisitor &>(*Parallel)
+                 : IR;
+  if (!generate(FileName, Opts, S, Visitor, Cache.get(), nullptr,
+                Parallel.get()))
+    return false;
+
+  if (Cache) {
+    // Functions are optimised one at a time as they're added to the cache.
+    if (!verify(FileName, Module))
+      return false;
+
+    try {
+      PhaseTimer Timer(CompilePhase::CP_Optimize);
+      Cache->finish(Opts.OptLevel, Machine);
+    } catch (const codegen::CodeGenException &Error) {
+      fmt::print("{}: Caught CodeGenException: \"{}\". Terminating "
+                 "compilation.\n",
+                 FileName, Error.what());
+      return false;
+    }
+  } else if (!Parallel &&
+             (Opts.OptLevel > 0 || Opts.Emit != EmitKind::EK_LLVMIR)) {
+    if (!verify(FileName, Module))
+      return false;
+
+    PhaseTimer Timer(CompilePhase::CP_Optimize);
+    codegen::optimize(Module, Opts.OptLevel, Machine);
+  }
+
+  PhaseTimer Timer(CompilePhase::CP_Emit);
+  if (OutputFileName.empty()) {
+    Module.print(llvm::errs(), nullptr);
+    return true;
+  }
+
+  const bool IsText = Opts.Emit == EmitKind::EK_LLVMIR ||
+                      Opts.Emit == EmitKind::EK_Assembly;
+  auto Out = openOutput(OutputFileName, IsText);
+  if (!Out)
+    return false;
+
+  try {
+    switch (Opts.Emit) {
+    case EmitKind::EK_LLVMIR:
+      Module.print(*Out, nullptr);
+      break;
+    case EmitKind::EK_Bitcode:
+      llvm::WriteBitcodeToFile(Module, *Out);
+      break;
+    case EmitKind::EK_Assembly:
+      Emitter->emitAssembly(Module, *Out);
+      break;
+    case EmitKind::EK_Object:
+      Emitter->emitObject(Module, *Out);
+      break;
+    case EmitKind::EK_Prelude:
+    case EmitKind::EK_AST:
+      // Written without generating code.
+      break;
+    }
+  } catch (const codegen::CodeGenException &Error) {
+    fmt::print("{}: Caught CodeGenException: \"{}\". Terminating "
+               "compilation.\n",
+               FileName, Error.what());
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+bool run(const Options &Opts) {
+  const auto &FileNames = Opts.FileNames;
+  std::atomic<size_t> NextFile(0);
+  std::atomic<bool> Success(true);
+  Session S(Opts);
+  if (!S.initialize(Opts))
+    return false;
+
+  std::optional<Trace> Tracing;
+  if (!Opts.TraceFileName.empty())
+    Tracing.emplace();
+
+  const auto Worker = [&]() {
+    TraceThread Traced(Tracing.has_value());
+    TimeReport::Activation Active(S.Report.get());
+    // Each worker owns its context so no LLVM state is shared between
+    // threads. Files compiled by the same worker reuse it, so LLVM's setup
+    // cost is only paid once per worker.
+    llvm::LLVMContext Context;
+
+    // Same goes for the target machine when emitting native code or
+    // optimising.
+    std::unique_ptr<codegen::TargetEmitter> Emitter;
+    if (Opts.Emit == EmitKind::EK_Assembly ||
+        Opts.Emit == EmitKind::EK_Object || Opts.OptLevel > 0) {
+      try {
+        Emitter = std::make_unique<codegen::TargetEmitter>(Opts.OptLevel);
+      } catch (const codegen::CodeGenException &Error) {
+        fmt::print("Caught CodeGenException: \"{}\". Terminating "
+                   "compilation.\n",
+                   Error.what());
+        Success = false;
+        return;
+      }
+    }
+
+    for (size_t Index = NextFile++; Index < FileNames.size();
+         Index = NextFile++) {
+      const auto &FileName = FileNames[Index];
+      if (!compile(FileName, outputFileName(FileName, Opts), Opts, S, Context,
+                   Emitter.get()))
+        Success = false;
+    }
+  };
+
+  const auto NumWorkers =
+      std::min<size_t>(std::max(Opts.Jobs, 1u), FileNames.size());
+  if (NumWorkers <= 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Workers;
+    for (size_t Index = 0; Index < NumWorkers; ++Index)
+      Workers.emplace_back(Worker);
+
+    for (auto &Thread : Workers)
+      Thread.join();
+  }
+
+  if (S.Report)
+    S.Report->print(Opts.TimeReportFormat == ReportFormat::RF_JSON);
+  if (Opts.Stats)
+    stats::print();
+  if (Tracing && !Tracing->write(Opts.TraceFileName))
+    return false;
+  return Success;
+}
+
+int execute(const Options &Opts) {
+  try {
+    Session S(Opts);
+    if (!S.initialize(Opts))
+      return 1;
+
+    std::optional<Trace> Tracing;
+    if (!Opts.TraceFileName.empty())
+      Tracing.emplace();
+
+    TimeReport::Activation Active(S.Report.get());
+    codegen::JIT Engine(Opts.OptLevel, Opts.Lazy);
+
+    // Every file goes into the same process so they can call each other. The
+    // JIT takes ownership of each module's context along with the module.
+    for (const auto &FileName : Opts.FileNames) {
+      llvm::TimeTraceScope Scope("Compile", FileName);
+      auto Context = std::make_unique<llvm::LLVMContext>();
+      codegen::IRGenerator IR(*Context);
+      if (S.PCH)
+        for (auto *Decl : S.PCH->getDecls())
+          IR.addPrototype(*Decl);
+
+      if (!generate(FileName, Opts, S, IR))
+        return 1;
+
+      auto &Module = IR.getModule();
+      Engine.configure(Module);
+      if (!verify(FileName, Module))
+        return 1;
+
+      Engine.addModule(IR.takeModule(), std::move(Context));
+    }
+
+    // Compiling for the JIT happens as the program runs, so isn't reported.
+    if (S.Report)
+      S.Report->print(Opts.TimeReportFormat == ReportFormat::RF_JSON);
+    if (Opts.Stats)
+      stats::print();
+    if (Tracing && !Tracing->write(Opts.TraceFileName))
+      return 1;
+    return Engine.run(Opts.EntryName);
   } catch (const codegen::CodeGenException &Error) {
-    fmt::print("Caught CodeGenException: \"{}\". Terminating compilation.",
+    fmt::print("Caught CodeGenException: \"{}\". Terminating execution.\n",
                Error.what());
+    return 1;
   }
 }
 
@@ -1,9 +1,77 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace fantac {
 
-void run(const std::string &);
+enum class EmitKind {
+  EK_LLVMIR,
+  EK_Bitcode,
+  EK_Assembly,
+  EK_Object,
+  // Precompiled prelude of a header's prototypes and macros.
+  EK_Prelude,
+  // Serialised AST that can be compiled later without parsing.
+  EK_AST,
+};
+
+enum class ReportFormat {
+  RF_None,
+  RF_Table,
+  RF_JSON,
+};
+
+struct Options {
+  std::vector<std::string> FileNames;
+  // Only valid with a single input. Otherwise outputs are written next to
+  // their sources.
+  std::string OutputFileName;
+  EmitKind Emit = EmitKind::EK_LLVMIR;
+  // Number of files compiled concurrently.
+  unsigned int Jobs = 1;
+  // Number of threads generating and optimising the functions of each file.
+  unsigned int CodeGenJobs = 1;
+  // LLVM optimisation level, from 0 to 3.
+  unsigned int OptLevel = 0;
+  // Searched for angled includes, and for quoted ones after the including
+  // file's directory.
+  std::vector<std::string> IncludeDirectories;
+  // Macros defined before preprocessing each file, as name and value.
+  std::vector<std::pair<std::string, std::string>> Defines;
+  // Precompiled prelude that every file starts out with. None when empty.
+  std::string PreludeFileName;
+  // Reuse optimised functions from this directory when their source hasn't
+  // changed. Disabled when empty.
+  std::string CacheDirectory;
+  // Write out each function as soon as it's generated and free it, rather
+  // than building the whole module first. For LLVM IR, assembly and object
+  // output, so not with bitcode, preludes, ASTs, --run, --cache-dir or
+  // --pipeline.
+  bool Stream = false;
+  // Preprocess and parse each file on threads of their own while generating
+  // code on the calling thread.
+  bool Pipeline = false;
+  // Print the time and memory each phase of compilation took once done.
+  ReportFormat TimeReportFormat = ReportFormat::RF_None;
+  // Write a Chrome trace of the compilation here. Disabled when empty.
+  std::string TraceFileName;
+  // Print the front end's event counters once done.
+  bool Stats = false;
+  // JIT compile and call EntryName instead of writing any output.
+  bool Run = false;
+  // Only compile functions the first time they're called when running.
+  bool Lazy = false;
+  std::string EntryName = "main";
+};
+
+// Compiles every file within one process. Returns false if any of them failed
+// to compile.
+bool run(const Options &);
+
+// JIT compiles every file into this process and calls the entry point.
+// Returns its result, or 1 if any file failed to compile.
+int execute(const Options &);
 
 } // namespace fantac
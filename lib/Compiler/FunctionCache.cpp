@@ -0,0 +1,248 @@
+#include "FunctionCache.h"
+#include "TimeReport.h"
+
+#include <AST/AST.h>
+#include <CodeGen/IRGenerator.h>
+#include <CodeGen/Optimizer.h>
+
+#include <fmt/format.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+
+namespace fantac {
+
+namespace {
+
+// Bump this whenever the generated code changes so stale entries are ignored.
+constexpr const char *CacheVersion = "fantac-function-cache-1";
+
+// Only the types matter to callers, not the argument names.
+std::string prototypeToString(const ast::FunctionDecl &Decl) {
+  std::string Prototype = ast::cTypeToString(Decl.Return);
+  Prototype.push_back('(');
+  for (const auto &Arg : Decl.Args) {
+    Prototype.append(ast::cTypeToString(Arg.second));
+    Prototype.push_back(',');
+  }
+  Prototype.push_back(')');
+  return Prototype;
+}
+
+} // namespace
+
+std::string TokenRecorder::takeTokens() {
+  std::string Result;
+  Result.swap(Tokens);
+  Callees.clear();
+  return Result;
+}
+
+bool TokenRecorder::lex(parse::Token &Tok) {
+  const bool Result = Lexer->lex(Tok);
+
+  if (HasPending) {
+    const auto Size = static_cast<uint32_t>(Pending.Value.size());
+    Tokens.push_back(static_cast<char>(Pending.Kind));
+    Tokens.append(reinterpret_cast<const char *>(&Size), sizeof(Size));
+    Tokens.append(Pending.Value);
+
+    if (Pending.Kind == parse::TokenKind::TK_Identifier &&
+        Tok.Kind == parse::TokenKind::TK_OpenParen)
+      Callees.push_back(Pending.Value);
+  }
+
+  Pending = Tok;
+  HasPending = true;
+  return Result;
+}
+
+FunctionCache::FunctionCache(const std::string &Directory,
+                             const std::string &Flags,
+                             codegen::IRGenerator &IR)
+    : Directory(Directory), Flags(Flags), IR(IR) {}
+
+FunctionCache::~FunctionCache() = default;
+
+parse::ILexer &FunctionCache::track(parse::ILexer &L) {
+  Recorder.setLexer(L);
+  return Recorder;
+}
+
+void FunctionCache::addPrototype(ast::FunctionDecl &AST) {
+  Decls[AST.Name.id()] = &AST;
+  IR.addPrototype(AST);
+}
+
+void FunctionCache::finish(unsigned int OptLevel,
+                           llvm::TargetMachine *Machine) {
+  for (auto &[Key, Body] : Misses) {
+    {
+      PhaseTimer Timer(CompilePhase::CP_Verify);
+      if (llvm::verifyModule(*Body, &llvm::outs()))
+        throw codegen::CodeGenException("Generated invalid LLVM IR.");
+    }
+
+    {
+      PhaseTimer Timer(CompilePhase::CP_Optimize);
+      codegen::optimize(*Body, OptLevel, Machine);
+    }
+    store(Key, *Body);
+    Bodies.push_back(std::move(Body));
+  }
+
+  // A single linker so the destination module is only scanned once.
+  llvm::Linker Linker(IR.getModule());
+  for (auto &Body : Bodies)
+    if (Linker.linkInModule(std::move(Body)))
+      throw codegen::CodeGenException("Unable to link cached function.");
+
+  Bodies.clear();
+  Misses.clear();
+}
+
+void FunctionCache::visit(ast::FunctionDecl &AST) {
+  Recorder.takeTokens();
+  Decls[AST.Name.id()] = &AST;
+  AST.accept(IR);
+}
+
+void FunctionCache::visit(ast::FunctionDef &AST) {
+  const auto Name = AST.Decl->Name;
+  Decls[Name.id()] = AST.Decl;
+
+  llvm::SHA1 Hasher;
+  Hasher.update(fmt::format("{}\n{}\n", CacheVersion, Flags));
+
+  // Calls depend on the prototypes of the functions being called.
+  std::vector<ast::FunctionDecl *> Callees;
+  llvm::DenseSet<uint32_t> Seen;
+  for (const auto Callee : Recorder.getCallees()) {
+    const auto CalleeName = ast::Symbol::intern(Callee);
+    if (CalleeName == Name || !Seen.insert(CalleeName.id()).second)
+      continue;
+
+    const auto Decl = Decls.find(CalleeName.id());
+    if (Decl == Decls.end()) {
+      Hasher.update(fmt::format("{}:?;", Callee));
+      continue;
+    }
+
+    Hasher.update(
+        fmt::format("{}:{};", Callee, prototypeToString(*Decl->second)));
+    Callees.push_back(Decl->second);
+  }
+
+  Hasher.update(Recorder.takeTokens());
+  const auto Key = llvm::toHex(Hasher.final(), true);
+
+  AST.Decl->accept(IR);
+  if (auto Body = load(Key)) {
+    Bodies.push_back(std::move(Body));
+    return;
+  }
+
+  // Generate the function on its own, with just enough declarations for its
+  // calls to resolve.
+  codegen::IRGenerator FunctionIR(IR.getModule().getContext());
+  auto &Module = FunctionIR.getModule();
+  Module.setTargetTriple(IR.getModule().getTargetTriple());
+  Module.setDataLayout(IR.getModule().getDataLayout());
+  for (auto *Decl : Callees)
+    Decl->accept(FunctionIR);
+
+  AST.accept(FunctionIR);
+  Misses.emplace_back(Key, FunctionIR.takeModule());
+}
+
+void FunctionCache::visit(ast::VariableDecl &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::UnaryOp &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::BinaryOp &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::IfCond &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::TernaryCond &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::IntegerLiteral &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::FloatLiteral &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::CharLiteral &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::StringLiteral &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::VariableRef &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::WhileLoop &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::ForLoop &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::MemberAccess &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::FunctionCall &AST) { AST.accept(IR); }
+
+void FunctionCache::visit(ast::Return &AST) { AST.accept(IR); }
+
+std::string FunctionCache::entryPath(const std::string &Key) const {
+  llvm::SmallString<128> Path(Directory);
+  llvm::sys::path::append(Path, Key + ".bc");
+  return std::string(Path.str());
+}
+
+std::unique_ptr<llvm::Module> FunctionCache::load(const std::string &Key) {
+  auto Buffer = llvm::MemoryBuffer::getFile(entryPath(Key));
+  if (!Buffer)
+    return nullptr;
+
+  // Treat anything unreadable as a miss. It'll be overwritten.
+  auto Body = llvm::parseBitcodeFile((*Buffer)->getMemBufferRef(),
+                                     IR.getModule().getContext());
+  if (!Body) {
+    llvm::consumeError(Body.takeError());
+    return nullptr;
+  }
+
+  return std::move(*Body);
+}
+
+void FunctionCache::store(const std::string &Key, const llvm::Module &Body) {
+  // Other compilations may be reading or writing the same entry, so write to a
+  // temporary file and move it into place.
+  int FD;
+  llvm::SmallString<128> TempPath;
+  auto EC = llvm::sys::fs::create_directories(Directory);
+  if (!EC)
+    EC = llvm::sys::fs::createUniqueFile(entryPath(Key) + ".%%%%%%.tmp", FD,
+                                         TempPath);
+  if (EC) {
+    fmt::print("Unable to write to cache directory {}: {}.\n", Directory,
+               EC.message());
+    return;
+  }
+
+  {
+    llvm::raw_fd_ostream Out(FD, true);
+    llvm::WriteBitcodeToFile(Body, Out);
+  }
+
+  if ((EC = llvm::sys::fs::rename(TempPath, entryPath(Key)))) {
+    llvm::sys::fs::remove(TempPath);
+    fmt::print("Unable to write to cache directory {}: {}.\n", Directory,
+               EC.message());
+  }
+}
+
+} // namespace fantac
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <AST/ASTInterfaces.h>
+#include <Parse/ParseInterfaces.h>
+#include <Parse/Token.h>
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class Module;
+class TargetMachine;
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+class IRGenerator;
+
+} // namespace fantac::codegen
+
+namespace fantac {
+
+// Records the tokens the parser pulls through it along with the names of any
+// functions they call. The parser reads a token ahead, so each token is only
+// recorded once the next one is requested. That way a top level expression's
+// record ends with its own last token.
+class TokenRecorder : public parse::ILexer {
+public:
+  void setLexer(parse::ILexer &L) { Lexer = &L; }
+
+  // Returns the tokens recorded since the last call.
+  std::string takeTokens();
+  const std::vector<std::string_view> &getCallees() const { return Callees; }
+
+  // ILexer impl.
+  bool lex(parse::Token &) override;
+
+private:
+  parse::ILexer *Lexer = nullptr;
+  parse::Token Pending;
+  bool HasPending = false;
+  std::string Tokens;
+  std::vector<std::string_view> Callees;
+};
+
+// Persistent cache of optimised function definitions, stored as a bitcode file
+// per function within a directory. Entries are keyed by a hash of the
+// function's tokens, the prototypes of the functions it calls and the compiler
+// flags, so only functions where one of those changed are generated and
+// optimised again.
+//
+// Sits between the parser and the IRGenerator for one translation unit. Every
+// definition is only declared in the generator's module. Functions missing
+// from the cache are generated into a module of their own along with
+// declarations of the functions they call, and finish() links the bodies into
+// the translation unit's module. Since each function is optimised on its own,
+// nothing is inlined across functions.
+class FunctionCache : public ast::IASTVisitor {
+public:
+  // Flags should describe every compiler setting that affects the generated
+  // code.
+  FunctionCache(const std::string &Directory, const std::string &Flags,
+                codegen::IRGenerator &IR);
+  virtual ~FunctionCache();
+
+  // Wraps the lexer that the translation unit is parsed from.
+  parse::ILexer &track(parse::ILexer &);
+  // Makes a prototype known without declaring it in the module.
+  void addPrototype(ast::FunctionDecl &);
+  // Optimises and stores the functions that weren't in the cache, then links
+  // every function body into the generator's module. The machine, if any,
+  // tunes the optimisation pipeline to the target.
+  void finish(unsigned int OptLevel, llvm::TargetMachine *Machine);
+
+  // IASTVisitor impl.
+  void visit(ast::FunctionDecl &) override;
+  void visit(ast::FunctionDef &) override;
+  void visit(ast::VariableDecl &) override;
+  void visit(ast::UnaryOp &) override;
+  void visit(ast::BinaryOp &) override;
+  void visit(ast::IfCond &) override;
+  void visit(ast::TernaryCond &) override;
+  void visit(ast::IntegerLiteral &) override;
+  void visit(ast::FloatLiteral &) override;
+  void visit(ast::CharLiteral &) override;
+  void visit(ast::StringLiteral &) override;
+  void visit(ast::VariableRef &) override;
+  void visit(ast::WhileLoop &) override;
+  void visit(ast::ForLoop &) override;
+  void visit(ast::MemberAccess &) override;
+  void visit(ast::FunctionCall &) override;
+  void visit(ast::Return &) override;
+
+private:
+  std::string entryPath(const std::string &Key) const;
+  std::unique_ptr<llvm::Module> load(const std::string &Key);
+  void store(const std::string &Key, const llvm::Module &);
+
+  const std::string Directory;
+  const std::string Flags;
+  codegen::IRGenerator &IR;
+  TokenRecorder Recorder;
+  // Functions declared so far, keyed by ast::Symbol id.
+  llvm::DenseMap<uint32_t, ast::FunctionDecl *> Decls;
+  // Bodies loaded from the cache.
+  std::vector<std::unique_ptr<llvm::Module>> Bodies;
+  // Bodies that were generated, along with their keys.
+  std::vector<std::pair<std::string, std::unique_ptr<llvm::Module>>> Misses;
+};
+
+} // namespace fantac
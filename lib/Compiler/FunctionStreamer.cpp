@@ -0,0 +1,150 @@
+#include "FunctionStreamer.h"
+#include "NativeStreamer.h"
+#include "TimeReport.h"
+
+#include <AST/AST.h>
+#include <CodeGen/IRGenerator.h>
+
+#include <fmt/format.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+
+namespace fantac {
+
+FunctionStreamer::FunctionStreamer(codegen::IRGenerator &IR,
+                                   llvm::raw_ostream &Out,
+                                   unsigned int OptLevel,
+                                   llvm::TargetMachine *Machine)
+    : IR(IR), Out(&Out), Optimizer(OptLevel, Machine),
+      Scratch("Scratch", IR.getModule().getContext()) {
+  // Matches the header that printing the whole module would start with.
+  const auto &Module = IR.getModule();
+  Out << "; ModuleID = '" << Module.getModuleIdentifier() << "'\n";
+  Out << "source_filename = \"" << Module.getSourceFileName() << "\"\n";
+  if (!Module.getDataLayoutStr().empty())
+    Out << "target datalayout = \"" << Module.getDataLayoutStr() << "\"\n";
+  if (!Module.getTargetTriple().empty())
+    Out << "target triple = \"" << Module.getTargetTriple() << "\"\n";
+}
+
+FunctionStreamer::FunctionStreamer(codegen::IRGenerator &IR,
+                                   NativeStreamer &Native,
+                                   unsigned int OptLevel,
+                                   llvm::TargetMachine *Machine)
+    : IR(IR), Native(&Native), Optimizer(OptLevel, Machine),
+      Scratch("Scratch", IR.getModule().getContext()) {}
+
+void FunctionStreamer::finish() {
+  if (Native) {
+    Native->finish();
+    return;
+  }
+
+  PhaseTimer Timer(CompilePhase::CP_Emit);
+  // Printing what's left of the module once the definitions are gone covers
+  // the remaining declarations along with any attributes they refer to.
+  auto &Module = IR.getModule();
+  for (auto &F : llvm::make_early_inc_range(Module))
+    if (Printed.count(&F))
+      F.eraseFromParent();
+  Printed.clear();
+  if (Module.empty())
+    return;
+
+  std::string Rest;
+  llvm::raw_string_ostream OS(Rest);
+  Module.print(OS, nullptr);
+
+  // The header was printed up front and ends at the first blank line.
+  *Out << '\n' << llvm::StringRef(OS.str()).split("\n\n").second;
+}
+
+void FunctionStreamer::visit(ast::FunctionDecl &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::FunctionDef &AST) {
+  AST.accept(IR);
+
+  auto &Module = IR.getModule();
+  const auto Name = AST.Decl->Name.str();
+  auto *F = Module.getFunction(llvm::StringRef(Name.data(), Name.size()));
+  {
+    PhaseTimer Timer(CompilePhase::CP_Verify);
+    if (llvm::verifyFunction(*F, &llvm::outs()))
+      throw codegen::CodeGenException("Generated invalid LLVM IR.");
+  }
+
+  {
+    PhaseTimer Timer(CompilePhase::CP_Optimize);
+    Optimizer.optimize(*F);
+  }
+
+  // Constants stay in the module since they're emitted at the end.
+  if (Native) {
+    Native->emit(*F);
+    return;
+  }
+
+  PhaseTimer Timer(CompilePhase::CP_Emit);
+
+  // Every constant left in the module belongs to this function.
+  auto &Functions = Module.getFunctionList();
+  Scratch.getGlobalList().splice(Scratch.global_end(), Module.getGlobalList());
+  Scratch.getFunctionList().splice(Scratch.end(), Functions, F);
+
+  if (!Scratch.global_empty())
+    *Out << '\n';
+  for (auto &Global : Scratch.globals()) {
+    if (!Global.hasName())
+      Global.setName(fmt::format(".str.{}", NumConstants++));
+    Global.print(*Out);
+    *Out << '\n';
+  }
+
+  *Out << '\n';
+  F->print(*Out);
+  Printed.insert(F);
+
+  // Calls to the function from later definitions only need its declaration.
+  F->deleteBody();
+  Functions.splice(Functions.end(), Scratch.getFunctionList(), F);
+  for (auto &Global : llvm::make_early_inc_range(Scratch.globals())) {
+    Global.removeDeadConstantUsers();
+    Global.eraseFromParent();
+  }
+}
+
+void FunctionStreamer::visit(ast::VariableDecl &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::UnaryOp &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::BinaryOp &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::IfCond &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::TernaryCond &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::IntegerLiteral &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::FloatLiteral &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::CharLiteral &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::StringLiteral &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::VariableRef &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::WhileLoop &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::ForLoop &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::MemberAccess &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::FunctionCall &AST) { AST.accept(IR); }
+
+void FunctionStreamer::visit(ast::Return &AST) { AST.accept(IR); }
+
+} // namespace fantac
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <AST/ASTInterfaces.h>
+#include <CodeGen/Optimizer.h>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/Module.h>
+
+namespace llvm {
+
+class raw_ostream;
+class TargetMachine;
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+class IRGenerator;
+
+} // namespace fantac::codegen
+
+namespace fantac {
+
+class NativeStreamer;
+
+// Writes a translation unit's IR one function at a time. Sits between the
+// parser and the IRGenerator, and as soon as a definition has been generated
+// it's verified, optimised and printed along with the string constants it
+// uses. Its body is then freed, leaving only a declaration behind for later
+// calls, so memory use is bounded by the largest function rather than the
+// whole file. Since each function is optimised on its own, nothing is inlined
+// across functions. Assembly and object code are streamed the same way, with
+// each definition handed to a NativeStreamer instead of being printed.
+class FunctionStreamer : public ast::IASTVisitor {
+public:
+  // Prints the module header straight away. The machine, if any, tunes the
+  // optimisation pipeline to the target.
+  FunctionStreamer(codegen::IRGenerator &IR, llvm::raw_ostream &Out,
+                   unsigned int OptLevel, llvm::TargetMachine *Machine);
+  FunctionStreamer(codegen::IRGenerator &IR, NativeStreamer &Native,
+                   unsigned int OptLevel, llvm::TargetMachine *Machine);
+  virtual ~FunctionStreamer() = default;
+
+  // Prints the declarations of functions that weren't defined, or finishes
+  // the native file. The generator can't be used afterwards.
+  void finish();
+
+  // IASTVisitor impl.
+  void visit(ast::FunctionDecl &) override;
+  void visit(ast::FunctionDef &) override;
+  void visit(ast::VariableDecl &) override;
+  void visit(ast::UnaryOp &) override;
+  void visit(ast::BinaryOp &) override;
+  void visit(ast::IfCond &) override;
+  void visit(ast::TernaryCond &) override;
+  void visit(ast::IntegerLiteral &) override;
+  void visit(ast::FloatLiteral &) override;
+  void visit(ast::CharLiteral &) override;
+  void visit(ast::StringLiteral &) override;
+  void visit(ast::VariableRef &) override;
+  void visit(ast::WhileLoop &) override;
+  void visit(ast::ForLoop &) override;
+  void visit(ast::MemberAccess &) override;
+  void visit(ast::FunctionCall &) override;
+  void visit(ast::Return &) override;
+
+private:
+  codegen::IRGenerator &IR;
+  // Exactly one of these is set.
+  llvm::raw_ostream *Out = nullptr;
+  NativeStreamer *Native = nullptr;
+  codegen::FunctionOptimizer Optimizer;
+  // Printing a function numbers everything in its module first, which would
+  // add up to quadratic time as declarations pile up. Each definition is moved
+  // here along with its constants to be printed instead.
+  llvm::Module Scratch;
+  // Functions whose definitions have already been printed.
+  llvm::DenseSet<const llvm::Function *> Printed;
+  // Constants are freed along with the functions using them, so they're named
+  // to keep them distinct from later ones.
+  unsigned int NumConstants = 0;
+};
+
+} // namespace fantac
@@ -0,0 +1,101 @@
+#include "HeaderCache.h"
+#include "SourceBuffer.h"
+
+#include <Parse/Preprocessor.h>
+
+#include <fmt/format.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include <mutex>
+
+namespace fantac {
+
+HeaderCache::HeaderCache(std::vector<std::string> IncludeDirectories)
+    : IncludeDirectories(std::move(IncludeDirectories)) {}
+
+std::shared_ptr<const parse::IncludeFile>
+HeaderCache::load(std::string_view Name, bool Angled,
+                  std::string_view IncluderPath) {
+  // Quoted includes depend on where they're included from.
+  const auto Directory =
+      Angled ? llvm::StringRef()
+             : llvm::sys::path::parent_path(
+                   llvm::StringRef(IncluderPath.data(), IncluderPath.size()));
+  const auto Key =
+      fmt::format("{}{}\n{}", Angled ? '<' : '"', Directory.str(), Name);
+
+  {
+    std::shared_lock<std::shared_mutex> Lock(Mutex);
+    const auto Found = Lookups.find(Key);
+    if (Found != Lookups.end())
+      return Found->second;
+  }
+
+  auto File = find(Name, Angled, std::string_view(Directory.data(),
+                                                  Directory.size()));
+  std::unique_lock<std::shared_mutex> Lock(Mutex);
+  return Lookups.emplace(Key, std::move(File)).first->second;
+}
+
+std::shared_ptr<const parse::IncludeFile>
+HeaderCache::find(std::string_view Name, bool Angled,
+                  std::string_view Directory) {
+  const llvm::StringRef FileName(Name.data(), Name.size());
+  if (llvm::sys::path::is_absolute(FileName))
+    return llvm::sys::fs::is_regular_file(FileName)
+               ? loadFile(FileName.str())
+               : nullptr;
+
+  std::vector<std::string> Candidates;
+  if (!Angled) {
+    llvm::SmallString<128> Path(
+        llvm::StringRef(Directory.data(), Directory.size()));
+    llvm::sys::path::append(Path, FileName);
+    Candidates.emplace_back(Path.str());
+  }
+
+  for (const auto &IncludeDirectory : IncludeDirectories) {
+    llvm::SmallString<128> Path(IncludeDirectory);
+    llvm::sys::path::append(Path, FileName);
+    Candidates.emplace_back(Path.str());
+  }
+
+  for (const auto &Candidate : Candidates)
+    if (llvm::sys::fs::is_regular_file(Candidate))
+      return loadFile(Candidate);
+
+  return nullptr;
+}
+
+std::shared_ptr<const parse::IncludeFile>
+HeaderCache::loadFile(const std::string &Path) {
+  // The same file can be reached through different paths.
+  llvm::SmallString<128> RealPath;
+  if (llvm::sys::fs::real_path(Path, RealPath))
+    RealPath = Path;
+
+  const auto Key = std::string(RealPath.str());
+  {
+    std::shared_lock<std::shared_mutex> Lock(Mutex);
+    const auto Found = Files.find(Key);
+    if (Found != Files.end())
+      return Found->second;
+  }
+
+  // Lex outside the lock. If another thread beats us to it, its copy wins.
+  std::shared_ptr<const parse::IncludeFile> File;
+  try {
+    SourceBuffer Source(Key);
+    File = std::make_shared<const parse::IncludeFile>(
+        Key, std::string(Source.begin(), Source.end()));
+  } catch (const parse::ParseException &Error) {
+    throw parse::ParseException(fmt::format("{}: {}", Key, Error.what()));
+  }
+
+  std::unique_lock<std::shared_mutex> Lock(Mutex);
+  return Files.emplace(Key, std::move(File)).first->second;
+}
+
+} // namespace fantac
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Parse/ParseInterfaces.h>
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fantac {
+
+// Loads include files for every translation unit in the process. Each file is
+// read and lexed once, then its tokens are shared between every compilation
+// thread that includes it. Lookups are remembered too, so repeated includes
+// don't touch the filesystem again.
+class HeaderCache : public parse::IIncludeLoader {
+public:
+  explicit HeaderCache(std::vector<std::string> IncludeDirectories);
+  virtual ~HeaderCache() = default;
+
+  // IIncludeLoader impl.
+  std::shared_ptr<const parse::IncludeFile>
+  load(std::string_view Name, bool Angled,
+       std::string_view IncluderPath) override;
+
+private:
+  std::shared_ptr<const parse::IncludeFile> find(std::string_view Name,
+                                                 bool Angled,
+                                                 std::string_view Directory);
+  std::shared_ptr<const parse::IncludeFile> loadFile(const std::string &Path);
+
+  const std::vector<std::string> IncludeDirectories;
+  std::shared_mutex Mutex;
+  // Files by their real path.
+  std::unordered_map<std::string, std::shared_ptr<const parse::IncludeFile>>
+      Files;
+  // What each include resolved to, including failures.
+  std::unordered_map<std::string, std::shared_ptr<const parse::IncludeFile>>
+      Lookups;
+};
+
+} // namespace fantac
@@ -0,0 +1,140 @@
+#include "NativeStreamer.h"
+#include "TimeReport.h"
+#include "Trace.h"
+
+#include <CodeGen/IRGenerator.h>
+#include <CodeGen/TargetEmitter.h>
+
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <optional>
+
+namespace fantac {
+
+// Runs last on each function, once it's been emitted. Frees the function's
+// body, then hands the module back to the generator until it has added the
+// next function.
+class NativeStreamer::Handoff : public llvm::FunctionPass {
+public:
+  static char ID;
+
+  explicit Handoff(NativeStreamer &Owner)
+      : llvm::FunctionPass(ID), Owner(Owner) {}
+
+  llvm::StringRef getPassName() const override {
+    return "Hand off to the IR generator";
+  }
+
+  bool runOnFunction(llvm::Function &F) override {
+    Timer.reset();
+    F.deleteBody();
+
+    std::unique_lock<std::mutex> Lock(Owner.Mutex);
+    Owner.Emitting = false;
+    Owner.TurnChanged.notify_all();
+    Owner.TurnChanged.wait(
+        Lock, [this]() { return Owner.Emitting || Owner.Finished; });
+    Timer.emplace(CompilePhase::CP_Emit, false);
+    return true;
+  }
+
+  // Counts the CPU time of emission, but not of waiting. The wall time is
+  // counted by the generator, which waits for each function to be emitted.
+  std::optional<PhaseTimer> Timer;
+
+private:
+  NativeStreamer &Owner;
+};
+
+char NativeStreamer::Handoff::ID = 0;
+
+NativeStreamer::NativeStreamer(llvm::Module &Module,
+                               codegen::TargetEmitter &Emitter,
+                               llvm::raw_fd_ostream &Out, bool Assembly)
+    : Module(Module), Passes(std::make_unique<llvm::legacy::PassManager>()) {
+  llvm::raw_pwrite_stream *OS = &Out;
+  if (!Out.supportsSeeking()) {
+    Buffer = std::make_unique<llvm::buffer_ostream>(Out);
+    OS = Buffer.get();
+  }
+
+  // Every code generation pass for a function runs before the next function
+  // is looked at, so the handoff comes after it's been written out.
+  Emitter.addPassesToEmit(*Passes, *OS, Assembly);
+  Feeder = new Handoff(*this);
+  Passes->add(Feeder);
+}
+
+NativeStreamer::~NativeStreamer() {
+  if (!CodeGen.joinable())
+    return;
+
+  // Generation failed part way, so the rest of the module isn't emitted. The
+  // code generator is waiting for the next function, so the module can be
+  // changed.
+  for (auto &F : Module)
+    F.deleteBody();
+
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Finished = true;
+    TurnChanged.notify_all();
+  }
+  CodeGen.join();
+}
+
+void NativeStreamer::emit(llvm::Function &F) {
+  PhaseTimer Timer(CompilePhase::CP_Emit);
+  // The code generator carries on from the end of the module.
+  auto &Functions = Module.getFunctionList();
+  Functions.splice(Functions.end(), Functions, F);
+
+  std::unique_lock<std::mutex> Lock(Mutex);
+  Emitting = true;
+  if (CodeGen.joinable())
+    TurnChanged.notify_all();
+  else
+    start();
+  TurnChanged.wait(Lock, [this]() { return !Emitting; });
+
+  if (!F.isDeclaration())
+    throw codegen::CodeGenException(
+        "Code generation stopped before every function was emitted.");
+}
+
+void NativeStreamer::finish() {
+  PhaseTimer Timer(CompilePhase::CP_Emit);
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Finished = true;
+    // Nothing was defined, but the file is still written.
+    if (!CodeGen.joinable())
+      start();
+    TurnChanged.notify_all();
+  }
+
+  CodeGen.join();
+  Buffer.reset();
+}
+
+void NativeStreamer::start() {
+  auto *Report = TimeReport::active();
+  const bool Traced = TraceThread::enabled();
+  CodeGen = std::thread([this, Report, Traced]() {
+    TraceThread Tracing(Traced);
+    TimeReport::Activation Active(Report);
+    Feeder->Timer.emplace(CompilePhase::CP_Emit, false);
+    Passes->run(Module);
+    Feeder->Timer.reset();
+
+    // Wakes the generator if the run ended before it was expected to.
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Emitting = false;
+    TurnChanged.notify_all();
+  });
+}
+
+} // namespace fantac
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace llvm {
+
+class Function;
+class Module;
+class buffer_ostream;
+class raw_fd_ostream;
+
+namespace legacy {
+
+class PassManager;
+
+} // namespace legacy
+
+} // namespace llvm
+
+namespace fantac::codegen {
+
+class TargetEmitter;
+
+} // namespace fantac::codegen
+
+namespace fantac {
+
+// Lowers a module to assembly or object code one function at a time while
+// it's still being generated, so each function's IR can be freed as soon as
+// it's been emitted. LLVM's code generator walks the module's functions in
+// order within a single run, so it runs on a thread of its own and pauses
+// after each function until the next one has been moved to the end of the
+// module. The threads take turns, so only one of them touches the module at a
+// time. Globals, such as string constants, are kept until the end of the file
+// since they're emitted last.
+class NativeStreamer {
+public:
+  NativeStreamer(llvm::Module &, codegen::TargetEmitter &,
+                 llvm::raw_fd_ostream &Out, bool Assembly);
+  ~NativeStreamer();
+  NativeStreamer(const NativeStreamer &) = delete;
+  NativeStreamer &operator=(const NativeStreamer &) = delete;
+
+  // Emits a function defined in the module and deletes its body, leaving a
+  // declaration for later calls. Returns once it's been emitted.
+  void emit(llvm::Function &);
+  // Emits the module's globals and finishes the file.
+  void finish();
+
+private:
+  class Handoff;
+
+  // Starts the code generator on the functions already in the module.
+  void start();
+
+  llvm::Module &Module;
+  // Object emission seeks back to patch headers, which pipes can't do.
+  std::unique_ptr<llvm::buffer_ostream> Buffer;
+  std::unique_ptr<llvm::legacy::PassManager> Passes;
+  // Owned by the pass manager.
+  Handoff *Feeder;
+  std::thread CodeGen;
+  std::mutex Mutex;
+  std::condition_variable TurnChanged;
+  // Whether the code generator has the module.
+  bool Emitting = false;
+  // Set once every function has been handed over.
+  bool Finished = false;
+};
+
+} // namespace fantac
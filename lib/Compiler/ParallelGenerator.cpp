@@ -0,0 +1,219 @@
+#include "ParallelGenerator.h"
+#include "TimeReport.h"
+#include "Trace.h"
+
+#include <AST/AST.h>
+#include <CodeGen/IRGenerator.h>
+#include <CodeGen/Optimizer.h>
+#include <CodeGen/TargetEmitter.h>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace fantac {
+
+namespace {
+
+// What a thread made of its run of definitions. Modules can't move between
+// contexts, so they're handed over as bitcode.
+struct Part {
+  llvm::SmallVector<char, 0> Bitcode;
+  std::exception_ptr Error;
+  // Position of the top level expression that failed.
+  size_t ErrorPosition = SIZE_MAX;
+  // Verifier output, if the IR was invalid.
+  std::string Diagnostics;
+};
+
+} // namespace
+
+ParallelGenerator::ParallelGenerator(codegen::IRGenerator &IR,
+                                     unsigned int Jobs)
+    : IR(IR), Jobs(Jobs) {}
+
+void ParallelGenerator::addPrototype(ast::FunctionDecl &AST) {
+  Prototypes.push_back(&AST);
+}
+
+bool ParallelGenerator::finish(unsigned int OptLevel) {
+  auto &Module = IR.getModule();
+  const auto NumParts =
+      std::max<size_t>(std::min<size_t>(Jobs, NumDefinitions), 1);
+  std::vector<Part> Parts(NumParts);
+  auto *Report = TimeReport::active();
+  const bool Traced = TraceThread::enabled();
+
+  const auto generate = [&](size_t Index) {
+    TraceThread Tracing(Traced);
+    TimeReport::Activation Active(Report);
+    PhaseTimer Timer(CompilePhase::CP_IRGen);
+    auto &Result = Parts[Index];
+    const auto Begin = NumDefinitions * Index / NumParts;
+    const auto End = NumDefinitions * (Index + 1) / NumParts;
+
+    llvm::LLVMContext Context;
+    codegen::IRGenerator PartIR(Context);
+    auto &PartModule = PartIR.getModule();
+    PartModule.setTargetTriple(Module.getTargetTriple());
+    PartModule.setDataLayout(Module.getDataLayout());
+    for (auto *Decl : Prototypes)
+      PartIR.addPrototype(*Decl);
+
+    size_t Position = 0;
+    try {
+      // Declarations and other threads' definitions are seen in the same
+      // order as on a single thread, so the same calls resolve.
+      size_t Definition = 0;
+      for (; Position < Functions.size(); ++Position) {
+        const auto &[Decl, Def] = Functions[Position];
+        if (!Def)
+          Decl->accept(PartIR);
+        else if (Definition == End)
+          break;
+        else if (Definition++ >= Begin)
+          Def->accept(PartIR);
+        else
+          PartIR.addPrototype(*Decl);
+      }
+
+      // Invalid IR is only reported after every function was generated.
+      Position = Functions.size();
+      {
+        PhaseTimer Timer(CompilePhase::CP_Verify);
+        llvm::raw_string_ostream Diagnostics(Result.Diagnostics);
+        if (llvm::verifyModule(PartModule, &Diagnostics)) {
+          Result.ErrorPosition = Position;
+          return;
+        }
+      }
+
+      {
+        PhaseTimer Timer(CompilePhase::CP_Optimize);
+        // Target machines aren't thread safe, so each thread tunes the
+        // pipeline with its own when the module is for the host.
+        std::unique_ptr<codegen::TargetEmitter> Target;
+        if (OptLevel > 0 && !PartModule.getTargetTriple().empty())
+          Target = std::make_unique<codegen::TargetEmitter>(OptLevel);
+        codegen::optimize(PartModule, OptLevel,
+                          Target ? &Target->getTargetMachine() : nullptr);
+      }
+      llvm::raw_svector_ostream Out(Result.Bitcode);
+      llvm::WriteBitcodeToFile(PartModule, Out);
+    } catch (...) {
+      Result.Error = std::current_exception();
+      Result.ErrorPosition = Position;
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (size_t Index = 1; Index < NumParts; ++Index)
+    Threads.emplace_back(generate, Index);
+  generate(0);
+  for (auto &Thread : Threads)
+    Thread.join();
+
+  const auto Failed = std::min_element(
+      Parts.begin(), Parts.end(), [](const Part &Left, const Part &Right) {
+        return Left.ErrorPosition < Right.ErrorPosition;
+      });
+  if (Failed->Error)
+    std::rethrow_exception(Failed->Error);
+  if (Failed->ErrorPosition != SIZE_MAX) {
+    llvm::outs() << Failed->Diagnostics;
+    return false;
+  }
+
+  // A single linker so the destination module is only scanned once.
+  PhaseTimer Timer(CompilePhase::CP_IRGen);
+  llvm::Linker Linker(Module);
+  for (const auto &Result : Parts) {
+    const llvm::MemoryBufferRef Buffer(
+        llvm::StringRef(Result.Bitcode.data(), Result.Bitcode.size()),
+        Module.getModuleIdentifier());
+    auto PartModule = llvm::parseBitcodeFile(Buffer, Module.getContext());
+    if (!PartModule) {
+      llvm::consumeError(PartModule.takeError());
+      throw codegen::CodeGenException("Unable to read generated functions.");
+    }
+
+    if (Linker.linkInModule(std::move(*PartModule)))
+      throw codegen::CodeGenException("Unable to link generated functions.");
+  }
+
+  // Puts the definitions back in source order, after the declarations.
+  auto &List = Module.getFunctionList();
+  for (const auto &[Decl, Def] : Functions) {
+    if (!Def)
+      continue;
+
+    const auto Name = Decl->Name.str();
+    if (auto *F =
+            Module.getFunction(llvm::StringRef(Name.data(), Name.size())))
+      List.splice(List.end(), List, F);
+  }
+
+  // Each part was verified on its own, which doesn't catch mistakes made
+  // while linking them together.
+  PhaseTimer VerifyTimer(CompilePhase::CP_Verify);
+  return !llvm::verifyModule(Module, &llvm::outs());
+}
+
+void ParallelGenerator::visit(ast::FunctionDecl &AST) {
+  Functions.emplace_back(&AST, nullptr);
+}
+
+void ParallelGenerator::visit(ast::FunctionDef &AST) {
+  Functions.emplace_back(AST.Decl, &AST);
+  ++NumDefinitions;
+}
+
+void ParallelGenerator::visit(ast::VariableDecl &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::UnaryOp &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::BinaryOp &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::IfCond &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::TernaryCond &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::IntegerLiteral &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::FloatLiteral &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::CharLiteral &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::StringLiteral &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::VariableRef &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::WhileLoop &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::ForLoop &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::MemberAccess &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::FunctionCall &) { unsupported(); }
+
+void ParallelGenerator::visit(ast::Return &) { unsupported(); }
+
+void ParallelGenerator::unsupported() {
+  throw codegen::CodeGenException(
+      "Only functions can be generated in parallel.");
+}
+
+} // namespace fantac
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <AST/ASTInterfaces.h>
+
+#include <utility>
+#include <vector>
+
+namespace fantac::codegen {
+
+class IRGenerator;
+
+} // namespace fantac::codegen
+
+namespace fantac {
+
+// Generates and optimises a translation unit's functions on several threads.
+// Sits between the parser and the IRGenerator, collecting top level
+// expressions until finish() splits the definitions into contiguous runs,
+// one per thread. Each thread generates its run into a module of its own,
+// with its own LLVMContext, knowing only the functions declared before each
+// definition, just like when generating on one thread. The modules are then
+// optimised in parallel and linked into the generator's module in order,
+// which is verified once more. Nothing is inlined between functions
+// generated on different threads, so a call to a small function in another
+// run isn't folded away as it would be on a single thread.
+class ParallelGenerator : public ast::IASTVisitor {
+public:
+  ParallelGenerator(codegen::IRGenerator &IR, unsigned int Jobs);
+  virtual ~ParallelGenerator() = default;
+
+  // Makes a prototype, such as a prelude's, known to every thread. It must
+  // outlive the generator.
+  void addPrototype(ast::FunctionDecl &);
+  // Generates, optimises and links every function. Errors are reported as
+  // the first one in the source would have been on a single thread. Returns
+  // false, having printed the verifier's output, if the IR of any run or of
+  // the linked module was invalid.
+  bool finish(unsigned int OptLevel);
+
+  // IASTVisitor impl.
+  void visit(ast::FunctionDecl &) override;
+  void visit(ast::FunctionDef &) override;
+  void visit(ast::VariableDecl &) override;
+  void visit(ast::UnaryOp &) override;
+  void visit(ast::BinaryOp &) override;
+  void visit(ast::IfCond &) override;
+  void visit(ast::TernaryCond &) override;
+  void visit(ast::IntegerLiteral &) override;
+  void visit(ast::FloatLiteral &) override;
+  void visit(ast::CharLiteral &) override;
+  void visit(ast::StringLiteral &) override;
+  void visit(ast::VariableRef &) override;
+  void visit(ast::WhileLoop &) override;
+  void visit(ast::ForLoop &) override;
+  void visit(ast::MemberAccess &) override;
+  void visit(ast::FunctionCall &) override;
+  void visit(ast::Return &) override;
+
+private:
+  [[noreturn]] void unsupported();
+
+  codegen::IRGenerator &IR;
+  const unsigned int Jobs;
+  std::vector<ast::FunctionDecl *> Prototypes;
+  // Top level expressions in order, as a declaration and, for definitions,
+  // the definition itself.
+  std::vector<std::pair<ast::FunctionDecl *, ast::FunctionDef *>> Functions;
+  size_t NumDefinitions = 0;
+};
+
+} // namespace fantac
@@ -0,0 +1,111 @@
+#include "Pipeline.h"
+#include "TimeReport.h"
+#include "Trace.h"
+
+#include <Parse/Parser.h>
+
+namespace fantac {
+
+// Feeds the parser from the token ring. Once the ring runs dry, it reads as
+// the end of the file, or throws whatever stopped the preprocessor. That way
+// errors come out in the same order as they would on one thread.
+class Pipeline::TokenReader : public parse::ILexer {
+public:
+  explicit TokenReader(Pipeline &Owner) : Owner(Owner) {}
+
+  bool lex(parse::Token &Tok) override {
+    if (!Owner.Tokens.pop(Tok)) {
+      if (Owner.LexError)
+        std::rethrow_exception(Owner.LexError);
+
+      Tok.assign(parse::TokenKind::TK_EOF);
+      return false;
+    }
+
+    return Tok.Kind != parse::TokenKind::TK_EOF;
+  }
+
+private:
+  Pipeline &Owner;
+};
+
+Pipeline::Pipeline(parse::ILexer &Lexer, ast::ASTArena &Arena) {
+  // Both threads time and trace into the caller's report and trace, if any.
+  // They mostly wait on the rings, so they only count CPU time. The caller
+  // counts the wall time it waits for each expression as parsing.
+  auto *Report = TimeReport::active();
+  const bool Traced = TraceThread::enabled();
+  Lexing = std::thread([this, &Lexer, Report, Traced]() {
+    TraceThread Tracing(Traced);
+    TimeReport::Activation Active(Report);
+    PhaseTimer Timer(CompilePhase::CP_Lex, false);
+    lexAll(Lexer);
+  });
+  Parsing = std::thread([this, &Arena, Report, Traced]() {
+    TraceThread Tracing(Traced);
+    TimeReport::Activation Active(Report);
+    PhaseTimer Timer(CompilePhase::CP_Parse, false);
+    parseAll(Arena);
+  });
+}
+
+Pipeline::~Pipeline() {
+  // Stops both threads early if the caller gave up on the rest of the file.
+  Exprs.cancel();
+  Tokens.cancel();
+  join();
+}
+
+ast::IAST *Pipeline::parseTopLevelExpr() {
+  ast::IAST *AST;
+  if (Exprs.pop(AST))
+    return AST;
+
+  join();
+  if (ParseError)
+    std::rethrow_exception(ParseError);
+
+  return nullptr;
+}
+
+void Pipeline::lexAll(parse::ILexer &Lexer) {
+  try {
+    parse::Token Tok;
+    bool More;
+    do {
+      More = Lexer.lex(Tok);
+      if (!Tokens.push(Tok))
+        break;
+    } while (More);
+  } catch (...) {
+    LexError = std::current_exception();
+  }
+
+  // Publishes the error along with the last tokens.
+  Tokens.close();
+}
+
+void Pipeline::parseAll(ast::ASTArena &Arena) {
+  try {
+    TokenReader Reader(*this);
+    parse::Parser P(Reader, Arena);
+    while (auto *AST = P.parseTopLevelExpr())
+      if (!Exprs.push(AST))
+        break;
+  } catch (...) {
+    ParseError = std::current_exception();
+  }
+
+  // The parser may stop before the end of the file.
+  Tokens.cancel();
+  Exprs.close();
+}
+
+void Pipeline::join() {
+  if (Lexing.joinable())
+    Lexing.join();
+  if (Parsing.joinable())
+    Parsing.join();
+}
+
+} // namespace fantac
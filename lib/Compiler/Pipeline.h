@@ -0,0 +1,50 @@
+#pragma once
+
+#include "SPSCRing.h"
+
+#include <AST/ASTArena.h>
+#include <Parse/ParseInterfaces.h>
+#include <Parse/Token.h>
+
+#include <exception>
+#include <thread>
+
+namespace fantac {
+
+// Preprocesses and parses a translation unit on threads of their own, ahead
+// of whoever asks for its top level expressions. One thread lexes and
+// preprocesses into a ring of tokens, another parses them into a ring of top
+// level expressions, and parseTopLevelExpr() takes them from there, so a
+// single file keeps up to three cores busy.
+//
+// Errors on either thread end the pipeline, and are rethrown from
+// parseTopLevelExpr() once the expressions before them have been read, as if
+// parsing had happened on the calling thread.
+class Pipeline : public parse::IParser {
+public:
+  // The lexer and the arena must outlive the pipeline, which starts straight
+  // away. The arena may only be used by the pipeline until it's finished.
+  Pipeline(parse::ILexer &, ast::ASTArena &);
+  virtual ~Pipeline();
+
+  // IParser impl.
+  ast::IAST *parseTopLevelExpr() override;
+
+private:
+  class TokenReader;
+
+  void lexAll(parse::ILexer &);
+  void parseAll(ast::ASTArena &);
+  void join();
+
+  // Tokens are small, so give the preprocessor plenty of room to run ahead.
+  SPSCRing<parse::Token, 4096> Tokens;
+  SPSCRing<ast::IAST *, 64> Exprs;
+  // Set before the ring they're about is closed, and only read afterwards.
+  std::exception_ptr LexError;
+  std::exception_ptr ParseError;
+  std::thread Lexing;
+  std::thread Parsing;
+};
+
+} // namespace fantac
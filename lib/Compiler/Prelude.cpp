@@ -0,0 +1,338 @@
+#include "Prelude.h"
+#include "SourceBuffer.h"
+
+#include <AST/AST.h>
+
+#include <fmt/format.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace fantac {
+
+namespace {
+
+// The file is a header followed by arrays of each kind of entry, in the order
+// the header lists their sizes, and finally the string data that entries refer
+// to. Everything is 4 byte aligned and in host byte order.
+constexpr char PreludeMagic[8] = {'F', 'A', 'N', 'T', 'A', 'P', 'C', 'H'};
+// Bump this whenever the layout or any of the serialised enums change.
+constexpr uint32_t PreludeVersion = 1;
+
+struct StringEntry {
+  uint32_t Offset;
+  uint32_t Size;
+};
+
+struct TypeEntry {
+  uint8_t Type;
+  uint8_t Length;
+  uint8_t Signed;
+  uint8_t Padding;
+  uint32_t Pointer;
+};
+
+struct DeclEntry {
+  StringEntry Name;
+  TypeEntry Return;
+  uint32_t FirstArg;
+  uint32_t NumArgs;
+};
+
+struct ArgEntry {
+  StringEntry Name;
+  TypeEntry Type;
+};
+
+struct MacroEntry {
+  StringEntry Name;
+  uint32_t FunctionLike;
+  uint32_t FirstParam;
+  uint32_t NumParams;
+  uint32_t FirstToken;
+  uint32_t NumTokens;
+};
+
+struct TokenEntry {
+  StringEntry Value;
+  uint8_t Kind;
+  uint8_t StartOfLine;
+  uint8_t LeadingSpace;
+  uint8_t Padding;
+};
+
+struct PreludeHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t NumDecls;
+  uint32_t NumArgs;
+  uint32_t NumMacros;
+  uint32_t NumParams;
+  uint32_t NumTokens;
+  uint32_t StringsSize;
+};
+
+// Hands out views of the entry arrays, checking that they fit in the file.
+class PreludeReader {
+public:
+  PreludeReader(const SourceBuffer &Buffer, const std::string &FileName)
+      : Current(Buffer.begin()), End(Buffer.end()), FileName(FileName) {}
+
+  template <typename T> const T *take(size_t Count) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 4,
+                  "Entries must be readable in place.");
+
+    if (Count > static_cast<size_t>(End - Current) / sizeof(T))
+      throw PreludeException(fmt::format("{} is truncated.", FileName));
+
+    const auto *Entries = reinterpret_cast<const T *>(Current);
+    Current += Count * sizeof(T);
+    return Entries;
+  }
+
+private:
+  const char *Current;
+  const char *End;
+  const std::string &FileName;
+};
+
+bool isInRange(uint32_t First, uint32_t Count, uint32_t Size) {
+  return static_cast<uint64_t>(First) + Count <= Size;
+}
+
+TypeEntry toTypeEntry(const ast::CType &Type) {
+  return {static_cast<uint8_t>(Type.Type), static_cast<uint8_t>(Type.Length),
+          static_cast<uint8_t>(Type.Signed), 0, Type.Pointer};
+}
+
+template <typename T> void writeArray(llvm::raw_ostream &Out, const T &Array) {
+  Out.write(reinterpret_cast<const char *>(Array.data()),
+            Array.size() * sizeof(Array.front()));
+}
+
+} // namespace
+
+Prelude::Prelude(const std::string &FileName) {
+  try {
+    Buffer = std::make_unique<SourceBuffer>(FileName);
+  } catch (const SourceException &Error) {
+    throw PreludeException(Error.what());
+  }
+
+  // Mapped files are page aligned and read ones come from the heap, so the
+  // entries can be used in place.
+  PreludeReader Reader(*Buffer, FileName);
+  const auto &Header = *Reader.take<PreludeHeader>(1);
+  if (std::memcmp(Header.Magic, PreludeMagic, sizeof(PreludeMagic)) != 0 ||
+      Header.Version != PreludeVersion)
+    throw PreludeException(fmt::format(
+        "{} is not a prelude written by this version of fantac.", FileName));
+
+  const auto *DeclEntries = Reader.take<DeclEntry>(Header.NumDecls);
+  const auto *ArgEntries = Reader.take<ArgEntry>(Header.NumArgs);
+  const auto *MacroEntries = Reader.take<MacroEntry>(Header.NumMacros);
+  const auto *ParamEntries = Reader.take<StringEntry>(Header.NumParams);
+  const auto *TokenEntries = Reader.take<TokenEntry>(Header.NumTokens);
+  const auto *Strings = Reader.take<char>(Header.StringsSize);
+
+  const auto corrupt = [&FileName]() {
+    return PreludeException(fmt::format("{} is corrupt.", FileName));
+  };
+
+  const auto toString = [&](const StringEntry &Entry) {
+    if (!isInRange(Entry.Offset, Entry.Size, Header.StringsSize))
+      throw corrupt();
+
+    return std::string_view(Strings + Entry.Offset, Entry.Size);
+  };
+
+  const auto toType = [&](const TypeEntry &Entry) {
+    if (Entry.Type > static_cast<uint8_t>(ast::CTypeKind::CTK_Void) ||
+        Entry.Length > static_cast<uint8_t>(ast::CLengthKind::CLK_LongLong) ||
+        Entry.Signed > 1)
+      throw corrupt();
+
+    return ast::CType(static_cast<ast::CTypeKind>(Entry.Type),
+                      static_cast<ast::CLengthKind>(Entry.Length),
+                      Entry.Signed != 0, Entry.Pointer);
+  };
+
+  std::vector<std::pair<ast::Symbol, ast::CType>> Args;
+  for (uint32_t Index = 0; Index < Header.NumDecls; ++Index) {
+    const auto &Entry = DeclEntries[Index];
+    if (!isInRange(Entry.FirstArg, Entry.NumArgs, Header.NumArgs))
+      throw corrupt();
+
+    Args.clear();
+    for (uint32_t Arg = 0; Arg < Entry.NumArgs; ++Arg) {
+      const auto &ArgEntry = ArgEntries[Entry.FirstArg + Arg];
+      Args.emplace_back(ast::Symbol::intern(toString(ArgEntry.Name)),
+                        toType(ArgEntry.Type));
+    }
+
+    Decls.push_back(Arena.create<ast::FunctionDecl>(
+        ast::Symbol::intern(toString(Entry.Name)), toType(Entry.Return),
+        Arena.copyArray(Args.data(), Args.size())));
+  }
+
+  for (uint32_t Index = 0; Index < Header.NumMacros; ++Index) {
+    const auto &Entry = MacroEntries[Index];
+    if (!isInRange(Entry.FirstParam, Entry.NumParams, Header.NumParams) ||
+        !isInRange(Entry.FirstToken, Entry.NumTokens, Header.NumTokens))
+      throw corrupt();
+
+    auto Definition = std::make_shared<parse::Preprocessor::Macro>();
+    Definition->FunctionLike = Entry.FunctionLike != 0;
+    for (uint32_t Param = 0; Param < Entry.NumParams; ++Param)
+      Definition->Params.push_back(
+          toString(ParamEntries[Entry.FirstParam + Param]));
+
+    for (uint32_t Tok = 0; Tok < Entry.NumTokens; ++Tok) {
+      const auto &TokEntry = TokenEntries[Entry.FirstToken + Tok];
+      if (TokEntry.Kind >= static_cast<uint8_t>(parse::TokenKind::TK_None))
+        throw corrupt();
+
+      auto &Body = Definition->Body.emplace_back();
+      Body.assign(static_cast<parse::TokenKind>(TokEntry.Kind),
+                  toString(TokEntry.Value));
+      Body.StartOfLine = TokEntry.StartOfLine != 0;
+      Body.LeadingSpace = TokEntry.LeadingSpace != 0;
+    }
+    parse::Preprocessor::validate(*Definition);
+
+    Macros.emplace_back(toString(Entry.Name), std::move(Definition));
+  }
+}
+
+Prelude::~Prelude() = default;
+
+void Prelude::define(parse::Preprocessor &PP) const {
+  for (const auto &[Name, Definition] : Macros)
+    PP.define(Name, Definition);
+}
+
+PreludeWriter::PreludeWriter(const std::string &OutputFileName)
+    : OutputFileName(OutputFileName) {}
+
+void PreludeWriter::finish(const parse::Preprocessor &PP) {
+  PreludeHeader Header = {};
+  std::memcpy(Header.Magic, PreludeMagic, sizeof(PreludeMagic));
+  Header.Version = PreludeVersion;
+
+  std::string Strings;
+  llvm::StringMap<StringEntry> StringEntries;
+  const auto addString = [&](std::string_view Str) {
+    const auto Inserted = StringEntries.try_emplace(
+        llvm::StringRef(Str.data(), Str.size()),
+        StringEntry{static_cast<uint32_t>(Strings.size()),
+                    static_cast<uint32_t>(Str.size())});
+    if (Inserted.second)
+      Strings.append(Str);
+
+    return Inserted.first->second;
+  };
+
+  std::vector<DeclEntry> DeclEntries;
+  std::vector<ArgEntry> ArgEntries;
+  for (const auto *Decl : Decls) {
+    DeclEntries.push_back({addString(Decl->Name.str()),
+                           toTypeEntry(Decl->Return),
+                           static_cast<uint32_t>(ArgEntries.size()),
+                           static_cast<uint32_t>(Decl->Args.size())});
+    for (const auto &Arg : Decl->Args)
+      ArgEntries.push_back(
+          {addString(Arg.first.str()), toTypeEntry(Arg.second)});
+  }
+
+  // Sort the macros so that the same header always gives the same file.
+  std::vector<std::pair<std::string_view,
+                        const parse::Preprocessor::Macro *>>
+      Macros;
+  for (const auto &[Name, Definition] : PP.getMacros())
+    Macros.emplace_back(Name, Definition.get());
+  std::sort(Macros.begin(), Macros.end());
+
+  std::vector<MacroEntry> MacroEntries;
+  std::vector<StringEntry> ParamEntries;
+  std::vector<TokenEntry> TokenEntries;
+  for (const auto &[Name, Definition] : Macros) {
+    MacroEntries.push_back({addString(Name), Definition->FunctionLike,
+                            static_cast<uint32_t>(ParamEntries.size()),
+                            static_cast<uint32_t>(Definition->Params.size()),
+                            static_cast<uint32_t>(TokenEntries.size()),
+                            static_cast<uint32_t>(Definition->Body.size())});
+    for (const auto Param : Definition->Params)
+      ParamEntries.push_back(addString(Param));
+    for (const auto &Tok : Definition->Body)
+      TokenEntries.push_back({addString(Tok.Value),
+                              static_cast<uint8_t>(Tok.Kind), Tok.StartOfLine,
+                              Tok.LeadingSpace, 0});
+  }
+
+  Header.NumDecls = DeclEntries.size();
+  Header.NumArgs = ArgEntries.size();
+  Header.NumMacros = MacroEntries.size();
+  Header.NumParams = ParamEntries.size();
+  Header.NumTokens = TokenEntries.size();
+  Header.StringsSize = Strings.size();
+
+  std::error_code EC;
+  llvm::raw_fd_ostream Out(OutputFileName, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    throw PreludeException(fmt::format("Unable to open output file {}: {}.",
+                                       OutputFileName, EC.message()));
+
+  Out.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  writeArray(Out, DeclEntries);
+  writeArray(Out, ArgEntries);
+  writeArray(Out, MacroEntries);
+  writeArray(Out, ParamEntries);
+  writeArray(Out, TokenEntries);
+  Out << Strings;
+}
+
+void PreludeWriter::visit(ast::FunctionDecl &AST) { Decls.push_back(&AST); }
+
+void PreludeWriter::visit(ast::FunctionDef &) { unsupported(); }
+
+void PreludeWriter::visit(ast::VariableDecl &) { unsupported(); }
+
+void PreludeWriter::visit(ast::UnaryOp &) { unsupported(); }
+
+void PreludeWriter::visit(ast::BinaryOp &) { unsupported(); }
+
+void PreludeWriter::visit(ast::IfCond &) { unsupported(); }
+
+void PreludeWriter::visit(ast::TernaryCond &) { unsupported(); }
+
+void PreludeWriter::visit(ast::IntegerLiteral &) { unsupported(); }
+
+void PreludeWriter::visit(ast::FloatLiteral &) { unsupported(); }
+
+void PreludeWriter::visit(ast::CharLiteral &) { unsupported(); }
+
+void PreludeWriter::visit(ast::StringLiteral &) { unsupported(); }
+
+void PreludeWriter::visit(ast::VariableRef &) { unsupported(); }
+
+void PreludeWriter::visit(ast::WhileLoop &) { unsupported(); }
+
+void PreludeWriter::visit(ast::ForLoop &) { unsupported(); }
+
+void PreludeWriter::visit(ast::MemberAccess &) { unsupported(); }
+
+void PreludeWriter::visit(ast::FunctionCall &) { unsupported(); }
+
+void PreludeWriter::visit(ast::Return &) { unsupported(); }
+
+void PreludeWriter::unsupported() {
+  throw PreludeException(
+      "Preludes may only contain function declarations.");
+}
+
+} // namespace fantac
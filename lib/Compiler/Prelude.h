@@ -0,0 +1,85 @@
+#pragma once
+
+#include <AST/ASTArena.h>
+#include <AST/ASTInterfaces.h>
+#include <Parse/Preprocessor.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fantac {
+
+class SourceBuffer;
+
+class PreludeException : public std::runtime_error {
+public:
+  template <typename T>
+  explicit PreludeException(T &&Error)
+      : std::runtime_error(std::forward<T>(Error)) {}
+  virtual ~PreludeException() = default;
+};
+
+// A precompiled prelude: the function prototypes and macros of a header, laid
+// out so that the file can be memory mapped and used without lexing or
+// parsing the header again. It's loaded once per process and shared by every
+// translation unit, which starts out as if it had included the header.
+class Prelude {
+public:
+  explicit Prelude(const std::string &FileName);
+  ~Prelude();
+
+  // Defines the prelude's macros.
+  void define(parse::Preprocessor &) const;
+  const std::vector<ast::FunctionDecl *> &getDecls() const { return Decls; }
+
+private:
+  // Macro names and tokens view the mapped file.
+  std::unique_ptr<SourceBuffer> Buffer;
+  ast::ASTArena Arena;
+  std::vector<ast::FunctionDecl *> Decls;
+  std::vector<std::pair<std::string_view,
+                        std::shared_ptr<const parse::Preprocessor::Macro>>>
+      Macros;
+};
+
+// Collects the prototypes of a header as it's parsed, then writes them along
+// with the preprocessor's macros as a prelude. Headers may only contain
+// function declarations.
+class PreludeWriter : public ast::IASTVisitor {
+public:
+  explicit PreludeWriter(const std::string &OutputFileName);
+  virtual ~PreludeWriter() = default;
+
+  void finish(const parse::Preprocessor &);
+
+  // IASTVisitor impl.
+  void visit(ast::FunctionDecl &) override;
+  void visit(ast::FunctionDef &) override;
+  void visit(ast::VariableDecl &) override;
+  void visit(ast::UnaryOp &) override;
+  void visit(ast::BinaryOp &) override;
+  void visit(ast::IfCond &) override;
+  void visit(ast::TernaryCond &) override;
+  void visit(ast::IntegerLiteral &) override;
+  void visit(ast::FloatLiteral &) override;
+  void visit(ast::CharLiteral &) override;
+  void visit(ast::StringLiteral &) override;
+  void visit(ast::VariableRef &) override;
+  void visit(ast::WhileLoop &) override;
+  void visit(ast::ForLoop &) override;
+  void visit(ast::MemberAccess &) override;
+  void visit(ast::FunctionCall &) override;
+  void visit(ast::Return &) override;
+
+private:
+  [[noreturn]] void unsupported();
+
+  const std::string OutputFileName;
+  std::vector<const ast::FunctionDecl *> Decls;
+};
+
+} // namespace fantac
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace fantac {
+
+// Bounded queue between exactly one producer thread and one consumer thread.
+// Neither side takes a lock: each only writes its own index and keeps a copy
+// of the other's, so the shared indices are only read again when the ring
+// looks full or empty. Waiting sides yield to other threads.
+//
+// The producer closes the ring once it's done, after which the consumer reads
+// what's left. The consumer cancels the ring when it stops reading early, so
+// the producer doesn't wait forever for room.
+template <typename T, size_t Capacity> class SPSCRing {
+  static_assert(Capacity && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two.");
+
+public:
+  // Returns false if the consumer cancelled, in which case the value is
+  // dropped.
+  bool push(const T &Value) {
+    const auto Tail = this->Tail.load(std::memory_order_relaxed);
+    while (Tail - HeadCopy == Capacity) {
+      HeadCopy = Head.load(std::memory_order_acquire);
+      if (Tail - HeadCopy != Capacity)
+        break;
+      if (Cancelled.load(std::memory_order_acquire))
+        return false;
+      std::this_thread::yield();
+    }
+
+    Slots[Tail & (Capacity - 1)] = Value;
+    this->Tail.store(Tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false once the ring has been closed and everything in it read.
+  bool pop(T &Value) {
+    const auto Head = this->Head.load(std::memory_order_relaxed);
+    while (Head == TailCopy) {
+      // Values pushed before closing are visible once it's seen as closed.
+      const bool IsClosed = Closed.load(std::memory_order_acquire);
+      TailCopy = Tail.load(std::memory_order_acquire);
+      if (Head != TailCopy)
+        break;
+      if (IsClosed)
+        return false;
+      std::this_thread::yield();
+    }
+
+    Value = Slots[Head & (Capacity - 1)];
+    this->Head.store(Head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Called by the producer.
+  void close() { Closed.store(true, std::memory_order_release); }
+  // Called by the consumer.
+  void cancel() { Cancelled.store(true, std::memory_order_release); }
+
+private:
+  std::array<T, Capacity> Slots;
+  // Written by the consumer, along with its copy of Tail.
+  alignas(64) std::atomic<size_t> Head{0};
+  size_t TailCopy = 0;
+  std::atomic<bool> Cancelled{false};
+  // Written by the producer, along with its copy of Head.
+  alignas(64) std::atomic<size_t> Tail{0};
+  size_t HeadCopy = 0;
+  std::atomic<bool> Closed{false};
+};
+
+} // namespace fantac
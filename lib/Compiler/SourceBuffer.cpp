@@ -0,0 +1,83 @@
+#include "SourceBuffer.h"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fantac {
+
+SourceBuffer::SourceBuffer(const std::string &FileName) {
+  if (FileName == "-") {
+    readAll(STDIN_FILENO, "<stdin>");
+    return;
+  }
+
+  const int FD = ::open(FileName.c_str(), O_RDONLY);
+  if (FD < 0)
+    throw SourceException(fmt::format("Unable to open {}: {}.", FileName,
+                                      std::strerror(errno)));
+
+  struct stat Stat;
+  if (::fstat(FD, &Stat) == 0 && S_ISREG(Stat.st_mode) && Stat.st_size > 0) {
+    const auto FileSize = static_cast<size_t>(Stat.st_size);
+    void *Mapping = ::mmap(nullptr, FileSize, PROT_READ, MAP_PRIVATE, FD, 0);
+    if (Mapping != MAP_FAILED) {
+      // The lexer makes a single forward pass.
+      ::madvise(Mapping, FileSize, MADV_SEQUENTIAL);
+      ::close(FD);
+      Data = static_cast<const char *>(Mapping);
+      Size = FileSize;
+      Mapped = true;
+      return;
+    }
+  }
+
+  // Not a regular file or mapping failed. Fall back to reading it.
+  try {
+    readAll(FD, FileName);
+  } catch (...) {
+    ::close(FD);
+    throw;
+  }
+
+  ::close(FD);
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (Mapped)
+    ::munmap(const_cast<char *>(Data), Size);
+}
+
+void SourceBuffer::readAll(int FD, const std::string &FileName) {
+  constexpr size_t ChunkSize = 64 * 1024;
+
+  size_t Length = 0;
+  while (true) {
+    Contents.resize(Length + ChunkSize);
+    const auto BytesRead = ::read(FD, &Contents[Length], ChunkSize);
+    if (BytesRead < 0) {
+      if (errno == EINTR)
+        continue;
+
+      throw SourceException(fmt::format("Unable to read {}: {}.", FileName,
+                                        std::strerror(errno)));
+    }
+
+    if (BytesRead == 0)
+      break;
+
+    Length += static_cast<size_t>(BytesRead);
+  }
+
+  Contents.resize(Length);
+  Data = Contents.data();
+  Size = Contents.size();
+}
+
+} // namespace fantac
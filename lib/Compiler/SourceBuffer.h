@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace fantac {
+
+class SourceException : public std::runtime_error {
+public:
+  template <typename T>
+  explicit SourceException(T &&Error)
+      : std::runtime_error(std::forward<T>(Error)) {}
+  virtual ~SourceException() = default;
+};
+
+// Read-only view of a source file. Regular files are memory mapped so the
+// lexer reads straight from the page cache. Anything that can't be mapped,
+// such as pipes or stdin (named by "-"), is read into memory instead.
+class SourceBuffer {
+public:
+  explicit SourceBuffer(const std::string &FileName);
+  ~SourceBuffer();
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+  const char *begin() const { return Data; }
+  const char *end() const { return Data + Size; }
+  size_t size() const { return Size; }
+  bool empty() const { return Size == 0; }
+  bool isMapped() const { return Mapped; }
+
+private:
+  void readAll(int FD, const std::string &FileName);
+
+  const char *Data = nullptr;
+  size_t Size = 0;
+  bool Mapped = false;
+  std::string Contents;
+};
+
+} // namespace fantac
@@ -0,0 +1,171 @@
+#include "TimeReport.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+#include <sys/resource.h>
+#include <time.h>
+
+namespace fantac {
+
+namespace {
+
+thread_local TimeReport *ActiveReport = nullptr;
+thread_local PhaseTimer *InnermostTimer = nullptr;
+
+struct PhaseName {
+  const char *Title;
+  const char *Key;
+};
+
+const PhaseName PhaseNames[] = {
+    {"Reading", "read"},
+    {"Lexing", "lex"},
+    {"Parsing", "parse"},
+    {"IR generation", "irgen"},
+    {"Verification", "verify"},
+    {"Optimisation", "optimize"},
+    {"Emission", "emit"},
+};
+
+double threadCPUSeconds() {
+  timespec Time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time);
+  return Time.tv_sec + Time.tv_nsec / 1e9;
+}
+
+size_t peakRSS() {
+  rusage Usage;
+  getrusage(RUSAGE_SELF, &Usage);
+  // Linux counts in KiB.
+  return static_cast<size_t>(Usage.ru_maxrss) * 1024;
+}
+
+double mebibytes(size_t Bytes) { return Bytes / (1024.0 * 1024.0); }
+
+// Enough that reading the clocks is lost in the cost of lexing.
+const size_t BatchSize = 256;
+
+} // namespace
+
+TimeReport::Activation::Activation(TimeReport *Report)
+    : Previous(ActiveReport) {
+  ActiveReport = Report;
+}
+
+TimeReport::Activation::~Activation() { ActiveReport = Previous; }
+
+TimeReport *TimeReport::active() { return ActiveReport; }
+
+void TimeReport::add(CompilePhase Phase, double WallSeconds,
+                     double CPUSeconds, size_t PeakRSS) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto &Entry = Phases[static_cast<size_t>(Phase)];
+  Entry.WallSeconds += WallSeconds;
+  Entry.CPUSeconds += CPUSeconds;
+  Entry.PeakRSS = std::max(Entry.PeakRSS, PeakRSS);
+}
+
+void TimeReport::print(bool JSON) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Times Total;
+  for (const auto &Entry : Phases) {
+    Total.WallSeconds += Entry.WallSeconds;
+    Total.CPUSeconds += Entry.CPUSeconds;
+    Total.PeakRSS = std::max(Total.PeakRSS, Entry.PeakRSS);
+  }
+
+  if (JSON) {
+    fmt::print("{{\"phases\": {{");
+    for (size_t Index = 0; Index < NumPhases; ++Index) {
+      const auto &Entry = Phases[Index];
+      fmt::print("{}\"{}\": {{\"wall\": {:.6f}, \"cpu\": {:.6f}, "
+                 "\"peak_rss\": {}}}",
+                 Index ? ", " : "", PhaseNames[Index].Key, Entry.WallSeconds,
+                 Entry.CPUSeconds, Entry.PeakRSS);
+    }
+    fmt::print("}}, \"total\": {{\"wall\": {:.6f}, \"cpu\": {:.6f}, "
+               "\"peak_rss\": {}}}}}\n",
+               Total.WallSeconds, Total.CPUSeconds, Total.PeakRSS);
+    return;
+  }
+
+  // Peak RSS is the most the process had used by the end of the phase.
+  fmt::print("{:<16}{:>12}{:>12}{:>18}\n", "Phase", "Wall (s)", "CPU (s)",
+             "Peak RSS (MiB)");
+  for (size_t Index = 0; Index < NumPhases; ++Index) {
+    const auto &Entry = Phases[Index];
+    fmt::print("{:<16}{:>12.4f}{:>12.4f}{:>18.1f}\n", PhaseNames[Index].Title,
+               Entry.WallSeconds, Entry.CPUSeconds, mebibytes(Entry.PeakRSS));
+  }
+  fmt::print("{:<16}{:>12.4f}{:>12.4f}{:>18.1f}\n", "Total",
+             Total.WallSeconds, Total.CPUSeconds, mebibytes(Total.PeakRSS));
+}
+
+PhaseTimer::PhaseTimer(CompilePhase Phase, bool CountWall)
+    : Report(TimeReport::active()), Phase(Phase), CountWall(CountWall) {
+  if (!Report)
+    return;
+
+  Parent = InnermostTimer;
+  InnermostTimer = this;
+  WallStart = std::chrono::steady_clock::now();
+  CPUStart = threadCPUSeconds();
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!Report)
+    return;
+
+  const double WallSeconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - WallStart)
+                                 .count();
+  const double CPUSeconds = threadCPUSeconds() - CPUStart;
+  InnermostTimer = Parent;
+  Report->add(Phase, CountWall ? WallSeconds - ChildWallSeconds : 0,
+              CPUSeconds - ChildCPUSeconds, peakRSS());
+  if (Parent) {
+    Parent->ChildWallSeconds += WallSeconds;
+    Parent->ChildCPUSeconds += CPUSeconds;
+  }
+}
+
+TimedLexer::TimedLexer(parse::ILexer &Lexer) : Lexer(Lexer) {
+  Batch.reserve(BatchSize);
+}
+
+bool TimedLexer::lex(parse::Token &Tok) {
+  if (Next == Batch.size()) {
+    if (Error)
+      std::rethrow_exception(Error);
+    fill();
+    if (Batch.empty())
+      std::rethrow_exception(Error);
+  }
+
+  Tok = Batch[Next];
+  // The end of the file is handed out again if the parser reads past it.
+  if (Done && Next + 1 == Batch.size())
+    return false;
+
+  ++Next;
+  return true;
+}
+
+void TimedLexer::fill() {
+  PhaseTimer Timer(CompilePhase::CP_Lex);
+  Batch.clear();
+  Next = 0;
+  try {
+    parse::Token Tok;
+    while (!Done && Batch.size() < BatchSize) {
+      Done = !Lexer.lex(Tok);
+      Batch.push_back(Tok);
+    }
+  } catch (...) {
+    Error = std::current_exception();
+  }
+}
+
+} // namespace fantac
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Parse/ParseInterfaces.h>
+#include <Parse/Token.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace fantac {
+
+enum class CompilePhase {
+  CP_Read,
+  // Includes preprocessing.
+  CP_Lex,
+  CP_Parse,
+  CP_IRGen,
+  CP_Verify,
+  CP_Optimize,
+  CP_Emit,
+};
+
+// Wall and CPU time spent in each phase of compilation across every thread,
+// along with the peak RSS of the process by the end of each, for
+// --time-report. Phases are timed by PhaseTimers on threads the report is
+// active on.
+class TimeReport {
+public:
+  // Makes a report the one timed into on the calling thread for as long as
+  // the activation lives. A null report turns timing off.
+  class Activation {
+  public:
+    explicit Activation(TimeReport *);
+    ~Activation();
+    Activation(const Activation &) = delete;
+    Activation &operator=(const Activation &) = delete;
+
+  private:
+    TimeReport *Previous;
+  };
+
+  // The report timed into on the calling thread, if any.
+  static TimeReport *active();
+
+  void add(CompilePhase, double WallSeconds, double CPUSeconds,
+           size_t PeakRSS);
+  // Prints a table, or a JSON object, to stdout.
+  void print(bool JSON) const;
+
+private:
+  struct Times {
+    double WallSeconds = 0;
+    double CPUSeconds = 0;
+    size_t PeakRSS = 0;
+  };
+
+  static constexpr size_t NumPhases =
+      static_cast<size_t>(CompilePhase::CP_Emit) + 1;
+
+  mutable std::mutex Mutex;
+  std::array<Times, NumPhases> Phases;
+};
+
+// Adds the time until it's destroyed to a phase of the active report, if
+// there is one. Time spent in timers nested within it only counts towards
+// theirs, so lexing on behalf of the parser isn't counted twice. Work done for
+// a thread that waits on it under a timer of its own only counts CPU time, so
+// the wall time isn't counted twice either.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(CompilePhase, bool CountWall = true);
+  ~PhaseTimer();
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+  TimeReport *const Report;
+  const CompilePhase Phase;
+  const bool CountWall;
+  PhaseTimer *Parent = nullptr;
+  std::chrono::steady_clock::time_point WallStart;
+  double CPUStart = 0;
+  double ChildWallSeconds = 0;
+  double ChildCPUSeconds = 0;
+};
+
+// Lexes ahead in batches under a timer, so the cost of lexing can be told
+// apart from parsing without reading the clock for every token. An error is
+// only thrown once the tokens before it have been read, as if lexing on
+// demand.
+class TimedLexer : public parse::ILexer {
+public:
+  explicit TimedLexer(parse::ILexer &);
+  virtual ~TimedLexer() = default;
+
+  // ILexer impl.
+  bool lex(parse::Token &) override;
+
+private:
+  void fill();
+
+  parse::ILexer &Lexer;
+  std::vector<parse::Token> Batch;
+  size_t Next = 0;
+  // Set once the lexer has reached the end of the file, which is the last
+  // token in the batch.
+  bool Done = false;
+  std::exception_ptr Error;
+};
+
+} // namespace fantac
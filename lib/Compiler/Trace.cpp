@@ -0,0 +1,49 @@
+#include "Trace.h"
+
+#include <fmt/format.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TimeProfiler.h>
+
+namespace fantac {
+
+namespace {
+
+// Spans are kept however short, since a file's functions are typically small
+// and the point is finding the odd one that isn't.
+const unsigned int GranularityMicroseconds = 0;
+
+} // namespace
+
+Trace::Trace() {
+  llvm::timeTraceProfilerInitialize(GranularityMicroseconds, "fantac");
+}
+
+Trace::~Trace() { llvm::timeTraceProfilerCleanup(); }
+
+bool Trace::write(const std::string &FileName) {
+  if (auto Error = llvm::timeTraceProfilerWrite(FileName, "fantac")) {
+    fmt::print("Unable to write trace to {}: {}.\n", FileName,
+               llvm::toString(std::move(Error)));
+    return false;
+  }
+
+  return true;
+}
+
+TraceThread::TraceThread(bool Enabled) {
+  if (!Enabled || llvm::timeTraceProfilerEnabled())
+    return;
+
+  llvm::timeTraceProfilerInitialize(GranularityMicroseconds, "fantac");
+  Started = true;
+}
+
+TraceThread::~TraceThread() {
+  // Hands the thread's spans over to be written with the rest.
+  if (Started)
+    llvm::timeTraceProfilerFinishThread();
+}
+
+bool TraceThread::enabled() { return llvm::timeTraceProfilerEnabled(); }
+
+} // namespace fantac
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+namespace fantac {
+
+// Chrome trace of the process for --trace-out, recorded by LLVM's time trace
+// profiler. Spans around each function parsed, generated and run through an
+// optimisation pass are tagged with its name. The calling thread is traced
+// until the trace is written, other threads through TraceThread.
+class Trace {
+public:
+  Trace();
+  ~Trace();
+  Trace(const Trace &) = delete;
+  Trace &operator=(const Trace &) = delete;
+
+  // Writes the spans of the calling thread and every finished TraceThread.
+  // Returns false on failure.
+  bool write(const std::string &FileName);
+};
+
+// Traces the calling thread for as long as it lives, if the process is being
+// traced. Threads that are already traced, like the one that owns the trace,
+// are left alone.
+class TraceThread {
+public:
+  explicit TraceThread(bool Enabled);
+  ~TraceThread();
+  // Whether the calling thread is traced, to pass on to threads it starts.
+  static bool enabled();
+  TraceThread(const TraceThread &) = delete;
+  TraceThread &operator=(const TraceThread &) = delete;
+
+private:
+  bool Started = false;
+};
+
+} // namespace fantac
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Token.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace fantac::parse {
+
+// Every keyword recognised by the lexer. The perfect hash below is generated
+// from this list at compile time so adding a keyword here is all it takes.
+inline constexpr std::pair<std::string_view, TokenKind> KeywordMappings[] = {
+    {"if", TokenKind::TK_If},         {"else", TokenKind::TK_Else},
+    {"for", TokenKind::TK_For},       {"while", TokenKind::TK_While},
+    {"return", TokenKind::TK_Return}, {"sizeof", TokenKind::TK_SizeOf},
+    {"void", TokenKind::TK_Void},     {"char", TokenKind::TK_Char},
+    {"int", TokenKind::TK_Int},       {"float", TokenKind::TK_Float},
+    {"double", TokenKind::TK_Double}, {"unsigned", TokenKind::TK_Unsigned},
+    {"short", TokenKind::TK_Short},   {"long", TokenKind::TK_Long},
+    {"enum", TokenKind::TK_Enum},     {"struct", TokenKind::TK_Struct}};
+
+// Perfect hash over KeywordMappings keyed on the length and the first and last
+// characters of a word. Classifying an identifier costs one multiply and one
+// string compare against the single candidate in its slot.
+class KeywordTable {
+public:
+  static constexpr unsigned int MaxSeedAttempts = 10000;
+
+  constexpr KeywordTable() {
+    while (!isPerfect(Seed) && Attempts < MaxSeedAttempts) {
+      Seed = nextSeed(Seed);
+      ++Attempts;
+    }
+
+    for (const auto &Mapping : KeywordMappings) {
+      Slots[hash(Mapping.first, Seed)] = {Mapping.first, Mapping.second};
+      MinLength = std::min(MinLength, Mapping.first.size());
+      MaxLength = std::max(MaxLength, Mapping.first.size());
+    }
+  }
+
+  // Returns the keyword kind of Word, or TK_Identifier if it isn't a keyword.
+  constexpr TokenKind lookup(std::string_view Word) const {
+    if (Word.size() < MinLength || Word.size() > MaxLength)
+      return TokenKind::TK_Identifier;
+
+    const auto &Candidate = Slots[hash(Word, Seed)];
+    return Candidate.Spelling == Word ? Candidate.Kind
+                                      : TokenKind::TK_Identifier;
+  }
+
+  // Number of seeds rejected before finding a collision free one.
+  constexpr unsigned int attempts() const { return Attempts; }
+
+private:
+  struct Slot {
+    std::string_view Spelling;
+    TokenKind Kind = TokenKind::TK_Identifier;
+  };
+
+  static constexpr size_t NumKeywords = std::size(KeywordMappings);
+
+  // Keep the load factor at or below a quarter so a seed is found quickly.
+  static constexpr unsigned int Bits = [] {
+    unsigned int Bits = 1;
+    while ((size_t(1) << Bits) < NumKeywords * 4)
+      ++Bits;
+    return Bits;
+  }();
+  static constexpr size_t Size = size_t(1) << Bits;
+
+  static constexpr uint32_t hash(std::string_view Word, uint32_t Seed) {
+    const uint32_t Key = static_cast<uint32_t>(Word.size()) << 16 |
+                         static_cast<unsigned char>(Word.front()) << 8 |
+                         static_cast<unsigned char>(Word.back());
+    return (Key * Seed) >> (32 - Bits);
+  }
+
+  static constexpr uint32_t nextSeed(uint32_t Seed) {
+    return (Seed + 0x9E3779B1u) | 1;
+  }
+
+  static constexpr bool isPerfect(uint32_t Seed) {
+    std::array<bool, Size> Occupied{};
+    for (const auto &Mapping : KeywordMappings) {
+      auto &Slot = Occupied[hash(Mapping.first, Seed)];
+      if (Slot)
+        return false;
+      Slot = true;
+    }
+    return true;
+  }
+
+  uint32_t Seed = 1;
+  unsigned int Attempts = 0;
+  size_t MinLength = SIZE_MAX, MaxLength = 0;
+  std::array<Slot, Size> Slots{};
+};
+
+inline constexpr KeywordTable Keywords;
+
+static_assert(Keywords.attempts() < KeywordTable::MaxSeedAttempts,
+              "Unable to find a perfect hash for the keyword set.");
+
+} // namespace fantac::parse
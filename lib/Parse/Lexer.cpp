@@ -1,133 +1,254 @@
 #include "Lexer.h"
+#include "Keywords.h"
 #include "Token.h"
 
+#include <Support/Statistics.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
 #include <cassert>
-#include <vector>
+#include <cstdint>
+#include <string_view>
 
 namespace fantac::parse {
 
 namespace {
 
-const std::vector<std::pair<char, TokenKind>> SymbolMappings = {
-    {'{', TokenKind::TK_OpenBrace},   {'}', TokenKind::TK_CloseBrace},
-    {'(', TokenKind::TK_OpenParen},   {')', TokenKind::TK_CloseParen},
-    {',', TokenKind::TK_Comma},       {';', TokenKind::TK_Semicolon},
-    {':', TokenKind::TK_Colon},       {'+', TokenKind::TK_Add},
-    {'-', TokenKind::TK_Subtract},    {'*', TokenKind::TK_Multiply},
-    {'/', TokenKind::TK_Divide},      {'<', TokenKind::TK_LessThan},
-    {'>', TokenKind::TK_GreaterThan}, {'=', TokenKind::TK_Assign},
-    {'.', TokenKind::TK_Period},      {'%', TokenKind::TK_Modulus},
-    {'&', TokenKind::TK_And},         {'|', TokenKind::TK_Or},
-    {'^', TokenKind::TK_Xor},         {'!', TokenKind::TK_Not},
-    {'#', TokenKind::TK_Hash}};
-
-const std::vector<std::pair<std::string, TokenKind>> CompoundSymbolMappings = {
+stats::KindCounter TokensLexed("lexer", "Tokens of kind", TokenKind::TK_None,
+                               tokenKindToString);
+stats::Counter LiteralsCopied("lexer", "Literals copied to unescape them");
+
+// Every operator and punctuator spelling. These are compiled into the
+// character class table and operator DFA below.
+constexpr std::pair<std::string_view, TokenKind> OperatorMappings[] = {
+    {"{", TokenKind::TK_OpenBrace},
+    {"}", TokenKind::TK_CloseBrace},
+    {"(", TokenKind::TK_OpenParen},
+    {")", TokenKind::TK_CloseParen},
+    {"[", TokenKind::TK_OpenSquareBracket},
+    {"]", TokenKind::TK_CloseSquareBracket},
+    {",", TokenKind::TK_Comma},
+    {";", TokenKind::TK_Semicolon},
+    {":", TokenKind::TK_Colon},
+    {"?", TokenKind::TK_Question},
+    {"+", TokenKind::TK_Add},
     {"+=", TokenKind::TK_AddEq},
+    {"++", TokenKind::TK_Increment},
+    {"-", TokenKind::TK_Subtract},
     {"-=", TokenKind::TK_SubtractEq},
+    {"--", TokenKind::TK_Decrement},
+    {"->", TokenKind::TK_Arrow},
+    {"*", TokenKind::TK_Multiply},
     {"*=", TokenKind::TK_MultiplyEq},
+    {"/", TokenKind::TK_Divide},
     {"/=", TokenKind::TK_DivideEq},
+    {"//", TokenKind::TK_SingleLineComment},
+    {"%", TokenKind::TK_Modulus},
     {"%=", TokenKind::TK_ModulusEq},
+    {"=", TokenKind::TK_Assign},
     {"==", TokenKind::TK_Equals},
+    {"<", TokenKind::TK_LessThan},
     {"<=", TokenKind::TK_LessThanEq},
-    {">=", TokenKind::TK_GreaterThanEq},
-    {"!=", TokenKind::TK_NotEquals},
     {"<<", TokenKind::TK_ShiftLeft},
     {"<<=", TokenKind::TK_ShiftLeftEq},
+    {">", TokenKind::TK_GreaterThan},
+    {">=", TokenKind::TK_GreaterThanEq},
     {">>", TokenKind::TK_ShiftRight},
     {">>=", TokenKind::TK_ShiftRightEq},
+    {"&", TokenKind::TK_And},
     {"&=", TokenKind::TK_AndEq},
-    {"|=", TokenKind::TK_OrEq},
-    {"^=", TokenKind::TK_XorEq},
     {"&&", TokenKind::TK_LogicalAnd},
+    {"|", TokenKind::TK_Or},
+    {"|=", TokenKind::TK_OrEq},
     {"||", TokenKind::TK_LogicalOr},
-    {"->", TokenKind::TK_Arrow},
-    {"//", TokenKind::TK_SingleLineComment}};
-
-const std::vector<std::pair<std::string, TokenKind>> KeywordMappings = {
-    {"if", TokenKind::TK_If},         {"else", TokenKind::TK_Else},
-    {"for", TokenKind::TK_For},       {"while", TokenKind::TK_While},
-    {"return", TokenKind::TK_Return}, {"sizeof", TokenKind::TK_SizeOf},
-    {"void", TokenKind::TK_Void},     {"char", TokenKind::TK_Char},
-    {"int", TokenKind::TK_Int},       {"float", TokenKind::TK_Float},
-    {"double", TokenKind::TK_Double}, {"unsigned", TokenKind::TK_Unsigned},
-    {"short", TokenKind::TK_Short},   {"long", TokenKind::TK_Long},
-    {"enum", TokenKind::TK_Enum},     {"struct", TokenKind::TK_Struct}};
-
-template <typename T>
-std::pair<bool, TokenKind>
-isSymbol(const T &Value, const std::vector<std::pair<T, TokenKind>> &Mappings) {
-  const auto MappingIter =
-      std::find_if(Mappings.begin(), Mappings.end(),
-                   [&Value](const std::pair<T, TokenKind> &SymbolPair) {
-                     return Value == SymbolPair.first;
-                   });
-
-  if (MappingIter == Mappings.end())
-    return std::make_pair(false, TokenKind::TK_None);
-
-  return std::make_pair(true, MappingIter->second);
+    {"^", TokenKind::TK_Xor},
+    {"^=", TokenKind::TK_XorEq},
+    {"!", TokenKind::TK_Not},
+    {"!=", TokenKind::TK_NotEquals},
+    {".", TokenKind::TK_Period},
+    {"#", TokenKind::TK_Hash},
+    {"##", TokenKind::TK_HashHash}};
+
+enum CharClass : uint8_t {
+  CC_None = 0,
+  CC_Space = 1 << 0,
+  CC_IdentifierStart = 1 << 1,
+  CC_Digit = 1 << 2,
+  CC_Operator = 1 << 3,
+  CC_IdentifierBody = CC_IdentifierStart | CC_Digit,
+};
+
+constexpr unsigned char toIndex(char C) {
+  return static_cast<unsigned char>(C);
 }
 
+// Classifies every input byte so the lexer can dispatch with one lookup.
+constexpr std::array<uint8_t, 256> CharClasses = [] {
+  std::array<uint8_t, 256> Classes{};
+  for (const char C : std::string_view(" \t\n\v\f\r"))
+    Classes[toIndex(C)] |= CC_Space;
+  for (char C = 'a'; C <= 'z'; ++C)
+    Classes[toIndex(C)] |= CC_IdentifierStart;
+  for (char C = 'A'; C <= 'Z'; ++C)
+    Classes[toIndex(C)] |= CC_IdentifierStart;
+  Classes[toIndex('_')] |= CC_IdentifierStart;
+  for (char C = '0'; C <= '9'; ++C)
+    Classes[toIndex(C)] |= CC_Digit;
+  for (const auto &Mapping : OperatorMappings)
+    Classes[toIndex(Mapping.first.front())] |= CC_Operator;
+  return Classes;
+}();
+
+char unescape(char C) {
+  switch (C) {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case 'v':
+    return '\v';
+  case 'f':
+    return '\f';
+  case 'a':
+    return '\a';
+  case 'b':
+    return '\b';
+  case '0':
+    return '\0';
+  case '\\':
+  case '\'':
+  case '\"':
+  case '?':
+    return C;
+  default:
+    throw ParseException(fmt::format("Unknown escape sequence: \\{}.", C));
+  }
+}
+
+bool hasCharClass(char C, uint8_t Class) {
+  return CharClasses[toIndex(C)] & Class;
+}
+
+// Maps each character that appears in an operator to a dense column in the DFA
+// transition table. Column 0 means the character can't continue an operator.
+constexpr std::array<uint8_t, 256> OperatorColumns = [] {
+  std::array<uint8_t, 256> Columns{};
+  uint8_t NextColumn = 1;
+  for (const auto &Mapping : OperatorMappings)
+    for (const char C : Mapping.first)
+      if (!Columns[toIndex(C)])
+        Columns[toIndex(C)] = NextColumn++;
+  return Columns;
+}();
+
+constexpr size_t NumOperatorColumns = [] {
+  size_t NumColumns = 0;
+  for (const auto Column : OperatorColumns)
+    NumColumns = std::max<size_t>(NumColumns, Column + 1);
+  return NumColumns;
+}();
+
+// Upper bound on DFA states: the root plus one per operator character.
+constexpr size_t MaxOperatorStates = [] {
+  size_t NumStates = 1;
+  for (const auto &Mapping : OperatorMappings)
+    NumStates += Mapping.first.size();
+  return NumStates;
+}();
+
+struct OperatorState {
+  // The operator recognised on reaching this state, or TK_None if the prefix
+  // read so far isn't an operator by itself.
+  TokenKind Kind;
+  // Next state for each operator column. State 0 is the root which is never
+  // transitioned into, so it doubles as "no transition".
+  std::array<uint8_t, NumOperatorColumns> Next;
+};
+
+// Trie over every operator spelling, walked with maximal munch.
+constexpr std::array<OperatorState, MaxOperatorStates> OperatorStates = [] {
+  std::array<OperatorState, MaxOperatorStates> States{};
+  for (auto &State : States)
+    State.Kind = TokenKind::TK_None;
+
+  uint8_t NumStates = 1;
+  for (const auto &Mapping : OperatorMappings) {
+    uint8_t Current = 0;
+    for (const char C : Mapping.first) {
+      auto &Next = States[Current].Next[OperatorColumns[toIndex(C)]];
+      if (!Next)
+        Next = NumStates++;
+      Current = Next;
+    }
+    States[Current].Kind = Mapping.second;
+  }
+  return States;
+}();
+
+static_assert(MaxOperatorStates <= 256,
+              "Operator DFA states must fit in the transition table.");
+
 } // namespace
 
 Lexer::Lexer(const char *Begin, const char *End)
     : CurrentChar(*Begin), Current(Begin + 1), End(End) {
-  assert(Begin < End);
+  assert(Begin <= End);
 }
 
 bool Lexer::lex(Token &Tok) {
   if (Current > End) {
     Tok.assign(TokenKind::TK_EOF);
+    Tok.StartOfLine = true;
     return false;
   }
 
-  return lexToken(Tok);
+  const bool More = lexToken(Tok);
+  if (More)
+    TokensLexed.add(Tok.Kind);
+  return More;
 }
 
 bool Lexer::lexToken(Token &Tok) {
-  // Trim any leading whitespace.
-  while (std::isspace(CurrentChar))
+  // Trim any leading whitespace. The preprocessor needs to know where lines
+  // start to find directives.
+  Tok.StartOfLine = AtStartOfLine;
+  Tok.LeadingSpace = false;
+  AtStartOfLine = false;
+  while (hasCharClass(CurrentChar, CC_Space)) {
+    Tok.StartOfLine |= CurrentChar == '\n';
+    Tok.LeadingSpace = true;
     if (!readNextChar()) {
       Tok.assign(TokenKind::TK_EOF);
+      Tok.StartOfLine = true;
       return false;
     }
+  }
 
-  if (std::isalpha(CurrentChar)) {
+  if (hasCharClass(CurrentChar, CC_IdentifierStart)) {
     lexIdentifier(Tok);
     return true;
   }
 
-  if (std::isdigit(CurrentChar)) {
+  if (hasCharClass(CurrentChar, CC_Digit)) {
     lexNumber(Tok);
     return true;
   }
 
-  const auto Result = isSymbol(CurrentChar, SymbolMappings);
-  if (Result.first) {
-    auto Kind = Result.second;
-    std::string CompoundSymbol{CurrentChar};
-    while (readNextChar()) {
-      if (std::isspace(CurrentChar))
-        continue;
-
-      CompoundSymbol.push_back(CurrentChar);
-      const auto CResult = isSymbol(CompoundSymbol, CompoundSymbolMappings);
-      if (!CResult.first) {
-        CompoundSymbol.pop_back();
-        break;
-      } else {
-        Kind = CResult.second;
-      }
-    }
+  if (hasCharClass(CurrentChar, CC_Operator)) {
+    lexOperator(Tok);
 
-    // TODO: Implement preprocessor. Until then just ignore.
-    if (Kind == TokenKind::TK_SingleLineComment || Kind == TokenKind::TK_Hash) {
+    // Skip comments up to the newline, which then starts the next token's
+    // line.
+    if (Tok.Kind == TokenKind::TK_SingleLineComment) {
       while (readNextChar() && CurrentChar != '\n') {
       }
       return lexToken(Tok);
     }
 
-    Tok.assign(Kind, std::move(CompoundSymbol));
     return true;
   }
 
@@ -147,56 +268,59 @@ bool Lexer::lexToken(Token &Tok) {
 }
 
 void Lexer::lexIdentifier(Token &Tok) {
-  std::string Identifier;
-  while (!std::isspace(CurrentChar) &&
-         !isSymbol(CurrentChar, SymbolMappings).first) {
-    if (!std::isalpha(CurrentChar) && CurrentChar != '_')
-      throw ParseException(
-          "Encountered non-alphabetical character in identifier name.");
-
-    Identifier.push_back(CurrentChar);
-    if (!readNextChar())
-      break;
-  }
-
-  auto KeywordIter = std::find_if(
-      KeywordMappings.begin(), KeywordMappings.end(),
-      [&Identifier](const std::pair<std::string, TokenKind> &KeywordPair) {
-        return Identifier == KeywordPair.first;
-      });
+  const char *Begin = Current - 1;
+  size_t Length = 0;
+  do
+    ++Length;
+  while (readNextChar() && hasCharClass(CurrentChar, CC_IdentifierBody));
+
+  // Either a keyword or just an identifier.
+  const std::string_view Identifier(Begin, Length);
+  Tok.assign(Keywords.lookup(Identifier), Identifier);
+}
 
-  // Recognised a keyword.
-  if (KeywordIter != KeywordMappings.end()) {
-    Tok.assign(KeywordIter->second, std::move(Identifier));
-    return;
-  }
+void Lexer::lexNumber(Token &Tok) {
+  const char *Begin = Current - 1;
+  size_t Length = 0;
+  bool More;
+  do
+    ++Length;
+  while ((More = readNextChar()) && hasCharClass(CurrentChar, CC_Digit));
 
-  // Otherwise it's just an identifier.
-  Tok.assign(TokenKind::TK_Identifier, std::move(Identifier));
+  // In the case of decimal, read after the period.
+  const bool IsFloat = More && CurrentChar == '.';
+  if (IsFloat)
+    do
+      ++Length;
+    while ((More = readNextChar()) && hasCharClass(CurrentChar, CC_Digit));
+
+  if (More && hasCharClass(CurrentChar, CC_IdentifierStart))
+    throw ParseException("Encountered non-numeric character in number.");
+
+  Tok.assign(IsFloat ? TokenKind::TK_FloatLiteral
+                     : TokenKind::TK_IntegerLiteral,
+             std::string_view(Begin, Length));
 }
 
-void Lexer::lexNumber(Token &Tok) {
-  std::string NumberLiteral;
-  while (!std::isspace(CurrentChar) &&
-         !isSymbol(CurrentChar, SymbolMappings).first) {
-    if (!std::isdigit(CurrentChar))
-      throw ParseException("Encountered non-numeric character in number.");
+void Lexer::lexOperator(Token &Tok) {
+  const char *Begin = Current - 1;
+  size_t Length = 0;
+  uint8_t State = 0;
 
-    NumberLiteral.push_back(CurrentChar);
-    if (!readNextChar())
+  // Follow the DFA for as long as the next character extends the operator.
+  do {
+    const auto Column = OperatorColumns[toIndex(CurrentChar)];
+    const auto Next = Column ? OperatorStates[State].Next[Column] : 0;
+    if (!Next)
       break;
-  }
 
-  // In the case of decimal, read after the period.
-  if (CurrentChar == '.') {
-    NumberLiteral.push_back(CurrentChar);
-    while (readNextChar() && !isSymbol(CurrentChar, SymbolMappings).first)
-      NumberLiteral.push_back(CurrentChar);
+    State = Next;
+    ++Length;
+  } while (readNextChar());
 
-    Tok.assign(TokenKind::TK_FloatLiteral, std::move(NumberLiteral));
-  } else {
-    Tok.assign(TokenKind::TK_IntegerLiteral, std::move(NumberLiteral));
-  }
+  const auto Kind = OperatorStates[State].Kind;
+  assert(Kind != TokenKind::TK_None);
+  Tok.assign(Kind, std::string_view(Begin, Length));
 }
 
 void Lexer::lexChar(Token &Tok) {
@@ -206,13 +330,24 @@ void Lexer::lexChar(Token &Tok) {
     throw ParseException(
         "Encountered opening single quote at the end of source.");
 
-  std::string CharLiteral{CurrentChar};
+  const char *Begin = Current - 1;
+  const bool Escaped = CurrentChar == '\\';
+  if (Escaped && !readNextChar())
+    throw ParseException("Encountered escape sequence at the end of source.");
+
+  const char CharLiteral = Escaped ? unescape(CurrentChar) : CurrentChar;
 
-  if (!readNextChar() && CurrentChar != '\'')
+  if (!readNextChar() || CurrentChar != '\'')
     throw ParseException(
         "Encountered character literal with a length greater than 1.");
 
-  Tok.assign(TokenKind::TK_CharLiteral, std::move(CharLiteral));
+  if (Escaped) {
+    LiteralsCopied.add();
+    Tok.assign(TokenKind::TK_CharLiteral,
+               UnescapedLiterals.emplace_back(1, CharLiteral));
+  } else {
+    Tok.assign(TokenKind::TK_CharLiteral, std::string_view(Begin, 1));
+  }
 }
 
 void Lexer::lexString(Token &Tok) {
@@ -222,16 +357,38 @@ void Lexer::lexString(Token &Tok) {
     throw ParseException(
         "Encountered open quotation mark at the end of source.");
 
-  std::string StringLiteral;
+  // Only copy the literal out of the source once we hit an escape sequence.
+  const char *Begin = Current - 1;
+  size_t Length = 0;
+  std::string *Unescaped = nullptr;
   while (CurrentChar != '\"') {
-    StringLiteral.push_back(CurrentChar);
+    if (CurrentChar == '\\') {
+      if (!Unescaped) {
+        LiteralsCopied.add();
+        Unescaped = &UnescapedLiterals.emplace_back(Begin, Length);
+      }
+
+      if (!readNextChar())
+        throw ParseException(
+            "Encountered escape sequence at the end of source.");
+
+      Unescaped->push_back(unescape(CurrentChar));
+    } else if (Unescaped) {
+      Unescaped->push_back(CurrentChar);
+    } else {
+      ++Length;
+    }
+
     if (!readNextChar())
       throw ParseException("String literal has no closing quotation mark.");
   }
 
   assert(CurrentChar == '\"');
 
-  Tok.assign(TokenKind::TK_StringLiteral, std::move(StringLiteral));
+  if (Unescaped)
+    Tok.assign(TokenKind::TK_StringLiteral, *Unescaped);
+  else
+    Tok.assign(TokenKind::TK_StringLiteral, std::string_view(Begin, Length));
 }
 
 bool Lexer::readNextChar() {
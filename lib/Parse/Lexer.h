@@ -2,6 +2,9 @@
 
 #include "ParseInterfaces.h"
 
+#include <deque>
+#include <string>
+
 namespace fantac::parse {
 
 class Lexer : public ILexer {
@@ -16,12 +19,17 @@ private:
   bool lexToken(Token &);
   void lexIdentifier(Token &);
   void lexNumber(Token &);
+  void lexOperator(Token &);
   void lexChar(Token &);
   void lexString(Token &);
   bool readNextChar();
 
   char CurrentChar;
   const char *Current, *End;
+  bool AtStartOfLine = true;
+  // Backing storage for literals whose value differs from their spelling in
+  // the source. Deque so that tokens viewing earlier entries stay valid.
+  std::deque<std::string> UnescapedLiterals;
 };
 
 } // namespace fantac::parse
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <stdexcept>
+#include <string_view>
 
 namespace fantac::ast {
 
@@ -29,11 +30,26 @@ public:
   virtual bool lex(Token &Tok) = 0;
 };
 
+struct IncludeFile;
+
+// Finds the files that the preprocessor is asked to include.
+class IIncludeLoader {
+public:
+  virtual ~IIncludeLoader() = default;
+
+  // Angled includes are only searched for in the include directories. Quoted
+  // ones are looked for next to the file including them first. Returns nullptr
+  // if the file can't be found.
+  virtual std::shared_ptr<const IncludeFile>
+  load(std::string_view Name, bool Angled, std::string_view IncluderPath) = 0;
+};
+
 class IParser {
 public:
   virtual ~IParser() = default;
 
-  virtual std::unique_ptr<ast::IAST> parseTopLevelExpr() = 0;
+  // Returned nodes are owned by the parser's ast::ASTArena.
+  virtual ast::IAST *parseTopLevelExpr() = 0;
 };
 
 } // namespace fantac::parse
@@ -1,34 +1,62 @@
 #include "Parser.h"
 
 #include <AST/AST.h>
+#include <Support/Statistics.h>
 
 #include <fmt/format.h>
+#include <llvm/Support/TimeProfiler.h>
 
 #include <algorithm>
 #include <cassert>
+#include <charconv>
 
 namespace fantac::parse {
 
-Parser::Parser(ILexer &Lexer) : Lexer(Lexer) { Lexer.lex(CurrentToken); }
+namespace {
+
+// The parser never rewinds. Instead it tries each alternative token in turn,
+// so every miss is a backtrack.
+stats::Counter ConsumeMisses("parser", "Tokens not matched by consumeToken");
+
+template <typename T> T parseNumber(std::string_view Literal) {
+  T Value{};
+  const auto Result =
+      std::from_chars(Literal.data(), Literal.data() + Literal.size(), Value);
+  if (Result.ec != std::errc() || Result.ptr != Literal.data() + Literal.size())
+    throw ParseException(fmt::format("Invalid numeric literal: {}.", Literal));
+
+  return Value;
+}
+
+} // namespace
+
+Parser::Parser(ILexer &Lexer, ast::ASTArena &Arena)
+    : Lexer(Lexer), Arena(Arena) {
+  Lexer.lex(CurrentToken);
+}
 
 ast::ASTPtr Parser::parseTopLevelExpr() {
   if (CurrentToken.Kind == TokenKind::TK_EOF)
     return nullptr;
 
   const auto Type = parseType();
-  auto Name = CurrentToken.Value;
+  const auto Name = CurrentToken.Value;
+  llvm::TimeTraceScope Scope("Parse",
+                             llvm::StringRef(Name.data(), Name.size()));
 
   // Function call.
   expectToken(TokenKind::TK_Identifier);
   if (consumeToken(TokenKind::TK_OpenParen))
-    return parseFunction(Type, std::move(Name));
+    return parseFunction(Type, Name);
 
   return nullptr;
 }
 
 bool Parser::consumeToken(TokenKind Kind) {
-  if (CurrentToken.Kind == TokenKind::TK_EOF || CurrentToken.Kind != Kind)
+  if (CurrentToken.Kind == TokenKind::TK_EOF || CurrentToken.Kind != Kind) {
+    ConsumeMisses.add();
     return false;
+  }
 
   Lexer.lex(CurrentToken);
   return true;
@@ -43,9 +71,9 @@ void Parser::expectToken(TokenKind Kind) {
                                      CurrentToken.Value));
 }
 
-ast::ASTPtr Parser::parseFunction(ast::CType Return, std::string &&Name) {
+ast::ASTPtr Parser::parseFunction(ast::CType Return, std::string_view Name) {
   // Parse arguments.
-  std::vector<std::pair<std::string, ast::CType>> Args;
+  std::vector<std::pair<ast::Symbol, ast::CType>> Args;
   while (!consumeToken(TokenKind::TK_CloseParen)) {
     // Skip commas between arguments.
     if (!Args.empty())
@@ -55,12 +83,13 @@ ast::ASTPtr Parser::parseFunction(ast::CType Return, std::string &&Name) {
     const auto ArgType = parseType();
 
     // Argument name.
-    Args.emplace_back(CurrentToken.Value, ArgType);
+    Args.emplace_back(ast::Symbol::intern(CurrentToken.Value), ArgType);
     expectToken(TokenKind::TK_Identifier);
   }
 
-  auto Decl = std::make_unique<ast::FunctionDecl>(std::move(Name), Return,
-                                                  std::move(Args));
+  auto *Decl = Arena.create<ast::FunctionDecl>(
+      ast::Symbol::intern(Name), Return,
+      Arena.copyArray(Args.data(), Args.size()));
 
   // Function declaration.
   if (consumeToken(TokenKind::TK_Semicolon))
@@ -69,11 +98,11 @@ ast::ASTPtr Parser::parseFunction(ast::CType Return, std::string &&Name) {
   expectToken(TokenKind::TK_OpenBrace);
 
   // Otherwise, function definition.
-  std::vector<ast::ASTPtr> Body;
+  const auto Mark = Scratch.size();
   while (!consumeToken(TokenKind::TK_CloseBrace))
-    Body.push_back(parseStatement());
+    Scratch.push_back(parseStatement());
 
-  return std::make_unique<ast::FunctionDef>(std::move(Decl), std::move(Body));
+  return Arena.create<ast::FunctionDef>(Decl, popScratch(Mark));
 }
 
 ast::ASTPtr Parser::parseStatement() {
@@ -90,11 +119,11 @@ ast::ASTPtr Parser::parseStatement() {
     // Return statement.
     if (consumeToken(TokenKind::TK_Semicolon))
       // Should be in a void function. Maybe check this?
-      return std::make_unique<ast::Return>(nullptr);
+      return Arena.create<ast::Return>(nullptr);
 
     auto ReturnExpr = parseExpr();
     expectToken(TokenKind::TK_Semicolon);
-    return std::make_unique<ast::Return>(std::move(ReturnExpr));
+    return Arena.create<ast::Return>(ReturnExpr);
   }
 
   // Variable declaration.
@@ -119,19 +148,18 @@ ast::ASTPtr Parser::parseStatement() {
 }
 
 ast::ASTPtr Parser::parseVariableDecl(ast::CType Type) {
-  auto Name = CurrentToken.Value;
+  const auto Name = ast::Symbol::intern(CurrentToken.Value);
   expectToken(TokenKind::TK_Identifier);
 
   // Parse assignment.
   if (consumeToken(TokenKind::TK_Assign)) {
     auto AssignmentExpr = parseExpr();
     expectToken(TokenKind::TK_Semicolon);
-    return std::make_unique<ast::VariableDecl>(Type, std::move(Name),
-                                               std::move(AssignmentExpr));
+    return Arena.create<ast::VariableDecl>(Type, Name, AssignmentExpr);
   }
 
   expectToken(TokenKind::TK_Semicolon);
-  return std::make_unique<ast::VariableDecl>(Type, std::move(Name));
+  return Arena.create<ast::VariableDecl>(Type, Name);
 }
 
 ast::ASTPtr Parser::parseIfCond() {
@@ -139,26 +167,29 @@ ast::ASTPtr Parser::parseIfCond() {
   auto Cond = parseExpr();
   expectToken(TokenKind::TK_CloseParen);
 
-  std::vector<ast::ASTPtr> Then, Else;
+  ast::ASTList Then, Else;
 
   if (consumeToken(TokenKind::TK_OpenBrace)) {
+    auto Mark = Scratch.size();
     while (!consumeToken(TokenKind::TK_CloseBrace))
-      Then.push_back(parseStatement());
+      Scratch.push_back(parseStatement());
+    Then = popScratch(Mark);
 
     if (consumeToken(TokenKind::TK_Else)) {
       expectToken(TokenKind::TK_OpenBrace);
+      Mark = Scratch.size();
       while (!consumeToken(TokenKind::TK_CloseBrace))
-        Else.push_back(parseStatement());
+        Scratch.push_back(parseStatement());
+      Else = popScratch(Mark);
     }
   } else {
     // Braceless conditional.
-    Then.push_back(parseStatement());
+    Then = makeList(parseStatement());
     if (consumeToken(TokenKind::TK_Else))
-      Else.push_back(parseStatement());
+      Else = makeList(parseStatement());
   }
 
-  return std::make_unique<ast::IfCond>(std::move(Cond), std::move(Then),
-                                       std::move(Else));
+  return Arena.create<ast::IfCond>(Cond, Then, Else);
 }
 
 ast::ASTPtr Parser::parseWhileLoop() {
@@ -166,16 +197,7 @@ ast::ASTPtr Parser::parseWhileLoop() {
   auto Cond = parseExpr();
   expectToken(TokenKind::TK_CloseParen);
 
-  std::vector<ast::ASTPtr> Body;
-
-  if (consumeToken(TokenKind::TK_OpenBrace))
-    while (!consumeToken(TokenKind::TK_CloseBrace))
-      Body.push_back(parseStatement());
-  else
-    // Braceless loop.
-    Body.push_back(parseStatement());
-
-  return std::make_unique<ast::WhileLoop>(std::move(Cond), std::move(Body));
+  return Arena.create<ast::WhileLoop>(Cond, parseLoopBody());
 }
 
 ast::ASTPtr Parser::parseForLoop() {
@@ -186,17 +208,19 @@ ast::ASTPtr Parser::parseForLoop() {
   auto Iter = parseExpr();
   expectToken(TokenKind::TK_CloseParen);
 
-  std::vector<ast::ASTPtr> Body;
+  return Arena.create<ast::ForLoop>(Init, Cond, Iter, parseLoopBody());
+}
 
-  if (consumeToken(TokenKind::TK_OpenBrace))
-    while (!consumeToken(TokenKind::TK_CloseBrace))
-      Body.push_back(parseStatement());
-  else
+ast::ASTList Parser::parseLoopBody() {
+  if (!consumeToken(TokenKind::TK_OpenBrace))
     // Braceless loop.
-    Body.push_back(parseStatement());
+    return makeList(parseStatement());
+
+  const auto Mark = Scratch.size();
+  while (!consumeToken(TokenKind::TK_CloseBrace))
+    Scratch.push_back(parseStatement());
 
-  return std::make_unique<ast::ForLoop>(std::move(Init), std::move(Cond),
-                                        std::move(Iter), std::move(Body));
+  return popScratch(Mark);
 }
 
 ast::ASTPtr Parser::parseExpr() {
@@ -205,28 +229,28 @@ ast::ASTPtr Parser::parseExpr() {
   if (!consumeToken(TokenKind::TK_Comma))
     return Left;
 
-  return std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                         parseExpr());
+  return Arena.create<ast::BinaryOp>(Operator, Left, parseExpr());
 }
 
 ast::ASTPtr Parser::parsePrimaryExpr() {
   const auto Kind = CurrentToken.Kind;
-  auto Identifier = CurrentToken.Value;
+  const auto Identifier = CurrentToken.Value;
   Lexer.lex(CurrentToken);
   switch (Kind) {
   case TokenKind::TK_IntegerLiteral:
-    return std::make_unique<ast::IntegerLiteral>(std::stoi(Identifier));
+    return Arena.create<ast::IntegerLiteral>(
+        parseNumber<unsigned int>(Identifier));
   case TokenKind::TK_FloatLiteral:
-    return std::make_unique<ast::FloatLiteral>(std::stof(Identifier));
+    return Arena.create<ast::FloatLiteral>(parseNumber<float>(Identifier));
   case TokenKind::TK_CharLiteral:
-    return std::make_unique<ast::CharLiteral>(Identifier.front());
+    return Arena.create<ast::CharLiteral>(Identifier.front());
   case TokenKind::TK_StringLiteral:
-    return std::make_unique<ast::StringLiteral>(std::move(Identifier));
+    return Arena.create<ast::StringLiteral>(Arena.copyString(Identifier));
   case TokenKind::TK_Identifier: {
     if (consumeToken(TokenKind::TK_OpenParen))
-      return parseFunctionCall(std::move(Identifier));
+      return parseFunctionCall(Identifier);
 
-    return std::make_unique<ast::VariableRef>(std::move(Identifier));
+    return Arena.create<ast::VariableRef>(ast::Symbol::intern(Identifier));
   }
   default:
     throw ParseException("Unknown primary expression.");
@@ -247,8 +271,7 @@ ast::ASTPtr Parser::parseAssignment() {
       consumeToken(TokenKind::TK_XorEq) ||
       consumeToken(TokenKind::TK_ShiftLeftEq) ||
       consumeToken(TokenKind::TK_ShiftRightEq))
-    return std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                           parseAssignment());
+    return Arena.create<ast::BinaryOp>(Operator, Left, parseAssignment());
 
   return Left;
 }
@@ -262,16 +285,14 @@ ast::ASTPtr Parser::parseTernary() {
   expectToken(TokenKind::TK_Colon);
   auto Else = parseTernary();
 
-  return std::make_unique<ast::TernaryCond>(std::move(Cond), std::move(Then),
-                                            std::move(Else));
+  return Arena.create<ast::TernaryCond>(Cond, Then, Else);
 }
 
 ast::ASTPtr Parser::parseLogicalOr() {
   auto Cond = parseLogicalAnd();
   const auto Operator = CurrentToken.Kind;
   while (consumeToken(TokenKind::TK_LogicalOr))
-    Cond = std::make_unique<ast::BinaryOp>(Operator, std::move(Cond),
-                                           parseLogicalAnd());
+    Cond = Arena.create<ast::BinaryOp>(Operator, Cond, parseLogicalAnd());
 
   return Cond;
 }
@@ -280,8 +301,7 @@ ast::ASTPtr Parser::parseLogicalAnd() {
   auto Left = parseBitwiseOr();
   const auto Operator = CurrentToken.Kind;
   while (consumeToken(TokenKind::TK_And))
-    Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                           parseLogicalAnd());
+    Left = Arena.create<ast::BinaryOp>(Operator, Left, parseLogicalAnd());
 
   return Left;
 }
@@ -290,8 +310,7 @@ ast::ASTPtr Parser::parseBitwiseOr() {
   auto Left = parseBitwiseXor();
   const auto Operator = CurrentToken.Kind;
   while (consumeToken(TokenKind::TK_Or))
-    Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                           parseBitwiseXor());
+    Left = Arena.create<ast::BinaryOp>(Operator, Left, parseBitwiseXor());
 
   return Left;
 }
@@ -300,8 +319,7 @@ ast::ASTPtr Parser::parseBitwiseXor() {
   auto Left = parseBitwiseAnd();
   const auto Operator = CurrentToken.Kind;
   while (consumeToken(TokenKind::TK_Xor))
-    Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                           parseBitwiseAnd());
+    Left = Arena.create<ast::BinaryOp>(Operator, Left, parseBitwiseAnd());
 
   return Left;
 }
@@ -310,8 +328,7 @@ ast::ASTPtr Parser::parseBitwiseAnd() {
   auto Left = parseEquality();
   const auto Operator = CurrentToken.Kind;
   while (consumeToken(TokenKind::TK_And))
-    Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                           parseEquality());
+    Left = Arena.create<ast::BinaryOp>(Operator, Left, parseEquality());
 
   return Left;
 }
@@ -322,8 +339,7 @@ ast::ASTPtr Parser::parseEquality() {
     const auto Operator = CurrentToken.Kind;
     if (consumeToken(TokenKind::TK_Equals) ||
         consumeToken(TokenKind::TK_NotEquals))
-      Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                             parseRelational());
+      Left = Arena.create<ast::BinaryOp>(Operator, Left, parseRelational());
     else
       return Left;
   }
@@ -337,8 +353,7 @@ ast::ASTPtr Parser::parseRelational() {
         consumeToken(TokenKind::TK_GreaterThan) ||
         consumeToken(TokenKind::TK_LessThanEq) ||
         consumeToken(TokenKind::TK_GreaterThanEq))
-      Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                             parseShift());
+      Left = Arena.create<ast::BinaryOp>(Operator, Left, parseShift());
     else
       return Left;
   }
@@ -350,8 +365,7 @@ ast::ASTPtr Parser::parseShift() {
     const auto Operator = CurrentToken.Kind;
     if (consumeToken(TokenKind::TK_ShiftLeft) ||
         consumeToken(TokenKind::TK_ShiftRight))
-      Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                             parseAddition());
+      Left = Arena.create<ast::BinaryOp>(Operator, Left, parseAddition());
     else
       return Left;
   }
@@ -362,8 +376,7 @@ ast::ASTPtr Parser::parseAddition() {
   while (true) {
     const auto Operator = CurrentToken.Kind;
     if (consumeToken(TokenKind::TK_Add) || consumeToken(TokenKind::TK_Subtract))
-      Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                             parseMultiplication());
+      Left = Arena.create<ast::BinaryOp>(Operator, Left, parseMultiplication());
     else
       return Left;
   }
@@ -376,8 +389,7 @@ ast::ASTPtr Parser::parseMultiplication() {
     if (consumeToken(TokenKind::TK_Multiply) ||
         consumeToken(TokenKind::TK_Divide) ||
         consumeToken(TokenKind::TK_Modulus))
-      Left = std::make_unique<ast::BinaryOp>(Operator, std::move(Left),
-                                             parseUnary());
+      Left = Arena.create<ast::BinaryOp>(Operator, Left, parseUnary());
     else
       return Left;
   }
@@ -386,22 +398,21 @@ ast::ASTPtr Parser::parseMultiplication() {
 ast::ASTPtr Parser::parseUnary() {
   const auto Operator = CurrentToken.Kind;
   if (consumeToken(TokenKind::TK_Subtract)) {
-    auto Zero = std::make_unique<ast::IntegerLiteral>(0);
-    return std::make_unique<ast::BinaryOp>(Operator, std::move(Zero),
-                                           parseUnary());
+    auto *Zero = Arena.create<ast::IntegerLiteral>(0);
+    return Arena.create<ast::BinaryOp>(Operator, Zero, parseUnary());
   }
 
   if (consumeToken(TokenKind::TK_Multiply) || consumeToken(TokenKind::TK_Add) ||
       consumeToken(TokenKind::TK_Not) || consumeToken(TokenKind::TK_SizeOf))
-    return std::make_unique<ast::UnaryOp>(Operator, parseUnary());
+    return Arena.create<ast::UnaryOp>(Operator, parseUnary());
 
   if (consumeToken(TokenKind::TK_Increment) ||
       consumeToken(TokenKind::TK_Decrement)) {
-    auto One = std::make_unique<ast::IntegerLiteral>(1);
-    return std::make_unique<ast::BinaryOp>(Operator == TokenKind::TK_Increment
-                                               ? TokenKind::TK_Add
-                                               : TokenKind::TK_Subtract,
-                                           parseUnary(), std::move(One));
+    auto *One = Arena.create<ast::IntegerLiteral>(1);
+    return Arena.create<ast::BinaryOp>(Operator == TokenKind::TK_Increment
+                                           ? TokenKind::TK_Add
+                                           : TokenKind::TK_Subtract,
+                                       parseUnary(), One);
   }
 
   return parsePostfix();
@@ -415,34 +426,32 @@ ast::ASTPtr Parser::parsePostfix() {
     // Post increment and decrement.
     if (consumeToken(TokenKind::TK_Increment) ||
         consumeToken(TokenKind::TK_Decrement)) {
-      Left = std::make_unique<ast::UnaryOp>(Operator, std::move(Left));
+      Left = Arena.create<ast::UnaryOp>(Operator, Left);
       continue;
     }
 
     // Member access.
     if (consumeToken(TokenKind::TK_Period)) {
-      Left = std::make_unique<ast::MemberAccess>(std::move(Left),
-                                                 CurrentToken.Value);
+      Left = Arena.create<ast::MemberAccess>(
+          Left, ast::Symbol::intern(CurrentToken.Value));
       expectToken(TokenKind::TK_Identifier);
       continue;
     }
 
     // Member access thru pointer.
     if (consumeToken(TokenKind::TK_Arrow)) {
-      Left = std::make_unique<ast::UnaryOp>(TokenKind::TK_Multiply,
-                                            std::move(Left));
-      Left = std::make_unique<ast::MemberAccess>(std::move(Left),
-                                                 CurrentToken.Value);
+      Left = Arena.create<ast::UnaryOp>(TokenKind::TK_Multiply, Left);
+      Left = Arena.create<ast::MemberAccess>(
+          Left, ast::Symbol::intern(CurrentToken.Value));
       expectToken(TokenKind::TK_Identifier);
       continue;
     }
 
     // Array access.
     if (consumeToken(TokenKind::TK_OpenSquareBracket)) {
-      Left = std::make_unique<ast::BinaryOp>(TokenKind::TK_Add, std::move(Left),
-                                             parseAssignment());
-      Left = std::make_unique<ast::UnaryOp>(TokenKind::TK_Multiply,
-                                            std::move(Left));
+      Left = Arena.create<ast::BinaryOp>(TokenKind::TK_Add, Left,
+                                         parseAssignment());
+      Left = Arena.create<ast::UnaryOp>(TokenKind::TK_Multiply, Left);
       expectToken(TokenKind::TK_CloseSquareBracket);
       continue;
     }
@@ -453,17 +462,29 @@ ast::ASTPtr Parser::parsePostfix() {
   return Left;
 }
 
-ast::ASTPtr Parser::parseFunctionCall(std::string &&FunctionName) {
-  std::vector<ast::ASTPtr> Args;
+ast::ASTPtr Parser::parseFunctionCall(std::string_view FunctionName) {
+  const auto Mark = Scratch.size();
   while (!consumeToken(TokenKind::TK_CloseParen)) {
-    if (!Args.empty())
+    if (Scratch.size() != Mark)
       expectToken(TokenKind::TK_Comma);
 
-    Args.push_back(parseAssignment());
+    Scratch.push_back(parseAssignment());
   }
 
-  return std::make_unique<ast::FunctionCall>(std::move(FunctionName),
-                                             std::move(Args));
+  return Arena.create<ast::FunctionCall>(ast::Symbol::intern(FunctionName),
+                                         popScratch(Mark));
+}
+
+ast::ASTList Parser::makeList(ast::ASTPtr Node) {
+  return Arena.copyArray(&Node, 1);
+}
+
+ast::ASTList Parser::popScratch(size_t Mark) {
+  assert(Mark <= Scratch.size());
+  const auto List =
+      Arena.copyArray(Scratch.data() + Mark, Scratch.size() - Mark);
+  Scratch.resize(Mark);
+  return List;
 }
 
 ast::CType Parser::parseType() {
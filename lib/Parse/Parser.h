@@ -5,6 +5,8 @@
 
 #include <AST/ASTInterfaces.h>
 
+#include <vector>
+
 namespace fantac::ast {
 
 struct CType;
@@ -16,7 +18,7 @@ namespace fantac::parse {
 
 class Parser : public IParser {
 public:
-  explicit Parser(ILexer &);
+  Parser(ILexer &, ast::ASTArena &);
   virtual ~Parser() = default;
 
   // IParser impl.
@@ -25,12 +27,13 @@ public:
 private:
   bool consumeToken(TokenKind);
   void expectToken(TokenKind);
-  ast::ASTPtr parseFunction(ast::CType, std::string &&);
+  ast::ASTPtr parseFunction(ast::CType, std::string_view);
   ast::ASTPtr parseStatement();
   ast::ASTPtr parseVariableDecl(ast::CType);
   ast::ASTPtr parseIfCond();
   ast::ASTPtr parseWhileLoop();
   ast::ASTPtr parseForLoop();
+  ast::ASTList parseLoopBody();
   ast::ASTPtr parseExpr();
   ast::ASTPtr parsePrimaryExpr();
   ast::ASTPtr parseAssignment();
@@ -47,11 +50,17 @@ private:
   ast::ASTPtr parseMultiplication();
   ast::ASTPtr parseUnary();
   ast::ASTPtr parsePostfix();
-  ast::ASTPtr parseFunctionCall(std::string &&);
+  ast::ASTPtr parseFunctionCall(std::string_view);
+  ast::ASTList makeList(ast::ASTPtr);
+  ast::ASTList popScratch(size_t);
   ast::CType parseType();
 
   ILexer &Lexer;
+  ast::ASTArena &Arena;
   Token CurrentToken;
+  // Child nodes of the lists currently being parsed. Nested lists are pushed
+  // above their parent's and popped into the arena before it continues.
+  std::vector<ast::ASTPtr> Scratch;
 };
 
 } // namespace fantac::parse
@@ -0,0 +1,869 @@
+#include "Preprocessor.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace fantac::parse {
+
+namespace {
+
+constexpr size_t MaxIncludeDepth = 200;
+
+// Keywords can be used as macro names too.
+bool isIdentifierLike(const Token &Tok) {
+  if (Tok.Value.empty() || Tok.Kind == TokenKind::TK_StringLiteral ||
+      Tok.Kind == TokenKind::TK_CharLiteral)
+    return false;
+
+  const auto Front = static_cast<unsigned char>(Tok.Value.front());
+  return std::isalpha(Front) || Front == '_';
+}
+
+std::string escape(std::string_view Value) {
+  std::string Escaped;
+  for (const char C : Value) {
+    switch (C) {
+    case '\n':
+      Escaped.append("\\n");
+      break;
+    case '\t':
+      Escaped.append("\\t");
+      break;
+    case '\r':
+      Escaped.append("\\r");
+      break;
+    case '\v':
+      Escaped.append("\\v");
+      break;
+    case '\f':
+      Escaped.append("\\f");
+      break;
+    case '\a':
+      Escaped.append("\\a");
+      break;
+    case '\0':
+      Escaped.append("\\0");
+      break;
+    case '\\':
+    case '\'':
+    case '\"':
+      Escaped.push_back('\\');
+      Escaped.push_back(C);
+      break;
+    default:
+      Escaped.push_back(C);
+    }
+  }
+
+  return Escaped;
+}
+
+// Literals hold their unescaped value, so put the quotes and escapes back.
+std::string spell(const Token &Tok) {
+  switch (Tok.Kind) {
+  case TokenKind::TK_StringLiteral:
+    return fmt::format("\"{}\"", escape(Tok.Value));
+  case TokenKind::TK_CharLiteral:
+    return fmt::format("'{}'", escape(Tok.Value));
+  default:
+    return std::string(Tok.Value);
+  }
+}
+
+// The lexer never reads the last character of its input, so make sure that's
+// a newline.
+std::string terminate(std::string Text) {
+  if (Text.empty() || Text.back() != '\n')
+    Text.push_back('\n');
+  return Text;
+}
+
+// Returns the name of the directive introduced by the hash at Index, if any.
+std::string_view directiveAt(const std::vector<Token> &Tokens, size_t Index) {
+  if (Index + 1 >= Tokens.size() || Tokens[Index].Kind != TokenKind::TK_Hash ||
+      !Tokens[Index].StartOfLine || Tokens[Index + 1].StartOfLine)
+    return std::string_view();
+
+  return Tokens[Index + 1].Value;
+}
+
+// Looks for the #ifndef X ... #endif include guard idiom wrapping the whole
+// file.
+std::string_view detectGuard(const std::vector<Token> &Tokens) {
+  if (directiveAt(Tokens, 0) != "ifndef" || Tokens.size() < 3 ||
+      Tokens[2].StartOfLine || !isIdentifierLike(Tokens[2]))
+    return std::string_view();
+
+  size_t Depth = 0;
+  for (size_t Index = 0; Index < Tokens.size(); ++Index) {
+    const auto Directive = directiveAt(Tokens, Index);
+    if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef") {
+      ++Depth;
+    } else if ((Directive == "else" || Directive == "elif") && Depth == 1) {
+      return std::string_view();
+    } else if (Directive == "endif" && --Depth == 0) {
+      // Only the rest of the #endif line may follow.
+      for (Index += 2; Index < Tokens.size(); ++Index)
+        if (Tokens[Index].StartOfLine)
+          return std::string_view();
+
+      return Tokens[2].Value;
+    }
+  }
+
+  return std::string_view();
+}
+
+// Evaluates the integer constant expression of an #if once macros have been
+// expanded. Any identifiers left over count as zero.
+class ConditionEvaluator {
+public:
+  explicit ConditionEvaluator(const std::vector<Token> &Tokens)
+      : Tokens(Tokens) {}
+
+  bool evaluate() {
+    if (Tokens.empty())
+      throw ParseException("Expected condition after #if.");
+
+    const auto Value = parseTernary();
+    if (Position != Tokens.size())
+      throw ParseException(fmt::format(
+          "Unexpected token in preprocessor condition: {}.",
+          Tokens[Position].Value));
+
+    return Value != 0;
+  }
+
+private:
+  static int precedence(TokenKind Kind) {
+    switch (Kind) {
+    case TokenKind::TK_LogicalOr:
+      return 1;
+    case TokenKind::TK_LogicalAnd:
+      return 2;
+    case TokenKind::TK_Or:
+      return 3;
+    case TokenKind::TK_Xor:
+      return 4;
+    case TokenKind::TK_And:
+      return 5;
+    case TokenKind::TK_Equals:
+    case TokenKind::TK_NotEquals:
+      return 6;
+    case TokenKind::TK_LessThan:
+    case TokenKind::TK_LessThanEq:
+    case TokenKind::TK_GreaterThan:
+    case TokenKind::TK_GreaterThanEq:
+      return 7;
+    case TokenKind::TK_ShiftLeft:
+    case TokenKind::TK_ShiftRight:
+      return 8;
+    case TokenKind::TK_Add:
+    case TokenKind::TK_Subtract:
+      return 9;
+    case TokenKind::TK_Multiply:
+    case TokenKind::TK_Divide:
+    case TokenKind::TK_Modulus:
+      return 10;
+    default:
+      return 0;
+    }
+  }
+
+  [[noreturn]] static void throwOverflow() {
+    throw ParseException("Integer overflow in preprocessor condition.");
+  }
+
+  static long long apply(TokenKind Kind, long long Left, long long Right) {
+    switch (Kind) {
+    case TokenKind::TK_LogicalOr:
+      return Left || Right;
+    case TokenKind::TK_LogicalAnd:
+      return Left && Right;
+    case TokenKind::TK_Or:
+      return Left | Right;
+    case TokenKind::TK_Xor:
+      return Left ^ Right;
+    case TokenKind::TK_And:
+      return Left & Right;
+    case TokenKind::TK_Equals:
+      return Left == Right;
+    case TokenKind::TK_NotEquals:
+      return Left != Right;
+    case TokenKind::TK_LessThan:
+      return Left < Right;
+    case TokenKind::TK_LessThanEq:
+      return Left <= Right;
+    case TokenKind::TK_GreaterThan:
+      return Left > Right;
+    case TokenKind::TK_GreaterThanEq:
+      return Left >= Right;
+    case TokenKind::TK_ShiftLeft: {
+      if (Right < 0 || Right >= 64)
+        return 0;
+
+      // Shifted unsigned, since shifting a negative value is undefined.
+      const auto Shifted = static_cast<long long>(
+          static_cast<unsigned long long>(Left) << Right);
+      if (Shifted >> Right != Left)
+        throwOverflow();
+      return Shifted;
+    }
+    case TokenKind::TK_ShiftRight:
+      return Right >= 0 && Right < 64 ? Left >> Right : 0;
+    case TokenKind::TK_Add:
+    case TokenKind::TK_Subtract:
+    case TokenKind::TK_Multiply: {
+      long long Result = 0;
+      bool Overflowed = false;
+      if (Kind == TokenKind::TK_Add)
+        Overflowed = __builtin_add_overflow(Left, Right, &Result);
+      else if (Kind == TokenKind::TK_Subtract)
+        Overflowed = __builtin_sub_overflow(Left, Right, &Result);
+      else
+        Overflowed = __builtin_mul_overflow(Left, Right, &Result);
+
+      if (Overflowed)
+        throwOverflow();
+      return Result;
+    }
+    case TokenKind::TK_Divide:
+    case TokenKind::TK_Modulus:
+      if (Right == 0)
+        throw ParseException("Division by zero in preprocessor condition.");
+      // The quotient doesn't fit, and the remainder traps on x86 too.
+      if (Left == std::numeric_limits<long long>::min() && Right == -1)
+        throwOverflow();
+      return Kind == TokenKind::TK_Divide ? Left / Right : Left % Right;
+    default:
+      assert(false);
+      return 0;
+    }
+  }
+
+  bool consume(TokenKind Kind) {
+    if (Position == Tokens.size() || Tokens[Position].Kind != Kind)
+      return false;
+
+    ++Position;
+    return true;
+  }
+
+  long long parseTernary() {
+    const auto Cond = parseBinary(1);
+    if (!consume(TokenKind::TK_Question))
+      return Cond;
+
+    const auto Then = parseTernary();
+    if (!consume(TokenKind::TK_Colon))
+      throw ParseException("Expected : in preprocessor condition.");
+
+    const auto Else = parseTernary();
+    return Cond ? Then : Else;
+  }
+
+  long long parseBinary(int MinPrecedence) {
+    auto Left = parseUnary();
+    while (Position < Tokens.size()) {
+      const auto Kind = Tokens[Position].Kind;
+      const auto Precedence = precedence(Kind);
+      if (Precedence == 0 || Precedence < MinPrecedence)
+        break;
+
+      ++Position;
+      Left = apply(Kind, Left, parseBinary(Precedence + 1));
+    }
+
+    return Left;
+  }
+
+  long long parseUnary() {
+    if (consume(TokenKind::TK_Not))
+      return !parseUnary();
+    if (consume(TokenKind::TK_Subtract)) {
+      long long Negated = 0;
+      if (__builtin_sub_overflow(0, parseUnary(), &Negated))
+        throwOverflow();
+      return Negated;
+    }
+    if (consume(TokenKind::TK_Add))
+      return parseUnary();
+
+    return parsePrimary();
+  }
+
+  long long parsePrimary() {
+    if (Position == Tokens.size())
+      throw ParseException("Unexpected end of preprocessor condition.");
+
+    if (consume(TokenKind::TK_OpenParen)) {
+      const auto Value = parseTernary();
+      if (!consume(TokenKind::TK_CloseParen))
+        throw ParseException("Expected ) in preprocessor condition.");
+
+      return Value;
+    }
+
+    const auto &Tok = Tokens[Position++];
+    if (Tok.Kind == TokenKind::TK_IntegerLiteral) {
+      long long Value = 0;
+      const auto *End = Tok.Value.data() + Tok.Value.size();
+      const auto Result = std::from_chars(Tok.Value.data(), End, Value);
+      if (Result.ec != std::errc() || Result.ptr != End)
+        throw ParseException(
+            fmt::format("Invalid integer in preprocessor condition: {}.",
+                        Tok.Value));
+
+      return Value;
+    }
+
+    if (Tok.Kind == TokenKind::TK_CharLiteral)
+      return Tok.Value.front();
+
+    if (isIdentifierLike(Tok))
+      return 0;
+
+    throw ParseException(fmt::format(
+        "Unexpected token in preprocessor condition: {}.", Tok.Value));
+  }
+
+  const std::vector<Token> &Tokens;
+  size_t Position = 0;
+};
+
+} // namespace
+
+IncludeFile::IncludeFile(std::string Path, std::string Contents)
+    : Path(std::move(Path)), Contents(terminate(std::move(Contents))) {
+  const auto *Begin = this->Contents.data();
+  FileLexer = std::make_unique<Lexer>(Begin, Begin + this->Contents.size() - 1);
+
+  Token Tok;
+  while (FileLexer->lex(Tok))
+    Tokens.push_back(Tok);
+
+  Guard = detectGuard(Tokens);
+}
+
+Preprocessor::Preprocessor(ILexer &Lexer, std::string Path,
+                           IIncludeLoader &Loader)
+    : Loader(Loader), MainPath(std::move(Path)) {
+  auto &Main = Sources.emplace_back();
+  Main.Lexer = &Lexer;
+  Main.Path = MainPath;
+}
+
+void Preprocessor::define(std::string_view Name, std::string_view Value) {
+  auto Definition = std::make_shared<Macro>();
+  Definition->Body = lexSpelling(std::string(Value));
+  validate(*Definition);
+  Macros[Spellings.emplace_back(Name)] = std::move(Definition);
+}
+
+void Preprocessor::validate(const Macro &Definition) {
+  const auto &Body = Definition.Body;
+  if (!Body.empty() && (Body.front().Kind == TokenKind::TK_HashHash ||
+                        Body.back().Kind == TokenKind::TK_HashHash))
+    throw ParseException("## cannot appear at either end of a macro body.");
+}
+
+void Preprocessor::define(std::string_view Name,
+                          std::shared_ptr<const Macro> Definition) {
+  Macros[Name] = std::move(Definition);
+}
+
+bool Preprocessor::lex(Token &Tok) {
+  while (next(Tok)) {
+    if (Macros.empty() || !isIdentifierLike(Tok))
+      return true;
+
+    const auto Found = Macros.find(Tok.Value);
+    if (Found == Macros.end() || isExpanding(Tok.Value))
+      return true;
+
+    // Keep the definition alive in case the arguments redefine it.
+    const auto Definition = Found->second;
+    if (!expandMacro(Tok, *Definition))
+      return true;
+  }
+
+  return false;
+}
+
+bool Preprocessor::next(Token &Tok) {
+  while (true) {
+    auto &Top = Sources.back();
+    if (!readSourceToken(Top, Tok)) {
+      if (Top.isFile() && Conditionals.size() != Top.ConditionalDepth)
+        throw ParseException(
+            fmt::format("Unterminated conditional directive in {}.", Top.Path));
+
+      if (Top.Barrier || Sources.size() == 1) {
+        Tok.assign(TokenKind::TK_EOF);
+        Tok.StartOfLine = true;
+        return false;
+      }
+
+      Sources.pop_back();
+      continue;
+    }
+
+    // Directives only come from files, never from macro expansions.
+    if (Top.isFile() && Tok.Kind == TokenKind::TK_Hash && Tok.StartOfLine) {
+      handleDirective();
+      continue;
+    }
+
+    if (isActive())
+      return true;
+  }
+}
+
+bool Preprocessor::readSourceToken(Source &From, Token &Tok) {
+  if (From.HasPending) {
+    Tok = From.Pending;
+    From.HasPending = false;
+    return true;
+  }
+
+  if (From.Lexer)
+    return From.Lexer->lex(Tok);
+
+  const auto &Tokens = From.File ? From.File->Tokens : From.Expansion;
+  if (From.Position == Tokens.size())
+    return false;
+
+  Tok = Tokens[From.Position++];
+  return true;
+}
+
+void Preprocessor::putBack(const Token &Tok) {
+  auto &Top = Sources.back();
+  assert(!Top.HasPending);
+  Top.Pending = Tok;
+  Top.HasPending = true;
+}
+
+void Preprocessor::readDirectiveLine(std::vector<Token> &Line) {
+  Token Tok;
+  while (readSourceToken(Sources.back(), Tok)) {
+    if (Tok.StartOfLine) {
+      putBack(Tok);
+      return;
+    }
+
+    Line.push_back(Tok);
+  }
+}
+
+void Preprocessor::handleDirective() {
+  std::vector<Token> Line;
+  readDirectiveLine(Line);
+
+  // A lone hash does nothing.
+  if (Line.empty())
+    return;
+
+  const auto Directive = Line.front().Value;
+  Line.erase(Line.begin());
+
+  if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef" ||
+      Directive == "elif" || Directive == "else" || Directive == "endif") {
+    handleConditional(Directive, Line);
+    return;
+  }
+
+  if (!isActive())
+    return;
+
+  if (Directive == "include") {
+    handleInclude(Line);
+  } else if (Directive == "define") {
+    handleDefine(Line);
+  } else if (Directive == "undef") {
+    if (Line.empty() || !isIdentifierLike(Line.front()))
+      throw ParseException("Expected macro name after #undef.");
+
+    Macros.erase(Line.front().Value);
+  } else if (Directive == "pragma") {
+    if (!Line.empty() && Line.front().Value == "once")
+      OnceOnly.insert(Sources.back().Path);
+  } else if (Directive == "error") {
+    std::string Message;
+    for (const auto &Tok : Line) {
+      if (!Message.empty())
+        Message.push_back(' ');
+      Message.append(spell(Tok));
+    }
+
+    throw ParseException(fmt::format("#error {}", Message));
+  } else if (Directive != "line") {
+    throw ParseException(
+        fmt::format("Unknown preprocessor directive #{}.", Directive));
+  }
+}
+
+void Preprocessor::handleInclude(std::vector<Token> &Line) {
+  if (Line.empty())
+    throw ParseException("Expected file name after #include.");
+
+  std::string Name;
+  const bool Angled = Line.front().Kind == TokenKind::TK_LessThan;
+  if (Angled) {
+    // The name was lexed as ordinary tokens, so glue them back together.
+    size_t Index = 1;
+    for (; Index < Line.size() && Line[Index].Kind != TokenKind::TK_GreaterThan;
+         ++Index)
+      Name.append(Line[Index].Value);
+
+    if (Index == Line.size())
+      throw ParseException("Expected > after #include file name.");
+  } else if (Line.front().Kind == TokenKind::TK_StringLiteral) {
+    Name = Line.front().Value;
+  } else {
+    throw ParseException("Expected \"FILENAME\" or <FILENAME> after #include.");
+  }
+
+  if (Sources.size() > MaxIncludeDepth)
+    throw ParseException(
+        fmt::format("#include of {} nested too deeply.", Name));
+
+  auto File = Loader.load(Name, Angled, Sources.back().Path);
+  if (!File) {
+    // The parser can't handle system headers, so they're skipped unless found
+    // in an include directory.
+    if (Angled)
+      return;
+
+    throw ParseException(fmt::format("Unable to find include file {}.", Name));
+  }
+
+  // No need to replay the file if it would come out empty.
+  if (OnceOnly.count(File->Path) ||
+      (!File->Guard.empty() && Macros.count(File->Guard)))
+    return;
+
+  Included.push_back(File);
+  auto &Top = Sources.emplace_back();
+  Top.File = std::move(File);
+  Top.Path = Top.File->Path;
+  Top.ConditionalDepth = Conditionals.size();
+}
+
+void Preprocessor::handleDefine(std::vector<Token> &Line) {
+  if (Line.empty() || !isIdentifierLike(Line.front()))
+    throw ParseException("Expected macro name after #define.");
+
+  auto Definition = std::make_shared<Macro>();
+  size_t Index = 1;
+
+  // Only function-like when the parenthesis directly follows the name.
+  if (Index < Line.size() && Line[Index].Kind == TokenKind::TK_OpenParen &&
+      !Line[Index].LeadingSpace) {
+    Definition->FunctionLike = true;
+    ++Index;
+
+    if (Index < Line.size() && Line[Index].Kind == TokenKind::TK_CloseParen) {
+      ++Index;
+    } else {
+      while (true) {
+        if (Index == Line.size() || !isIdentifierLike(Line[Index]))
+          throw ParseException("Expected parameter name in macro definition.");
+
+        Definition->Params.push_back(Line[Index++].Value);
+        if (Index < Line.size() && Line[Index].Kind == TokenKind::TK_Comma) {
+          ++Index;
+          continue;
+        }
+
+        if (Index < Line.size() &&
+            Line[Index].Kind == TokenKind::TK_CloseParen) {
+          ++Index;
+          break;
+        }
+
+        throw ParseException("Expected , or ) in macro parameter list.");
+      }
+    }
+  }
+
+  Definition->Body.assign(Line.begin() + Index, Line.end());
+  validate(*Definition);
+
+  Macros[Line.front().Value] = std::move(Definition);
+}
+
+void Preprocessor::handleConditional(std::string_view Directive,
+                                     std::vector<Token> &Line) {
+  if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef") {
+    // Nothing within a skipped block is evaluated.
+    if (!isActive()) {
+      Conditionals.push_back({false, true, false});
+      return;
+    }
+
+    bool Value;
+    if (Directive == "if") {
+      Value = evaluateCondition(Line);
+    } else {
+      if (Line.empty() || !isIdentifierLike(Line.front()))
+        throw ParseException(
+            fmt::format("Expected macro name after #{}.", Directive));
+
+      Value = (Macros.count(Line.front().Value) != 0) == (Directive == "ifdef");
+    }
+
+    Conditionals.push_back({Value, Value, false});
+    return;
+  }
+
+  if (Conditionals.size() == Sources.back().ConditionalDepth)
+    throw ParseException(fmt::format("#{} without #if.", Directive));
+
+  if (Directive == "endif") {
+    Conditionals.pop_back();
+    return;
+  }
+
+  auto &Current = Conditionals.back();
+  if (Current.SeenElse)
+    throw ParseException(fmt::format("#{} after #else.", Directive));
+
+  const bool ParentActive = Conditionals.size() < 2 ||
+                            Conditionals[Conditionals.size() - 2].Active;
+  if (Directive == "else") {
+    Current.SeenElse = true;
+    Current.Active = ParentActive && !Current.Taken;
+  } else {
+    Current.Active =
+        ParentActive && !Current.Taken && evaluateCondition(Line);
+  }
+
+  Current.Taken |= Current.Active;
+}
+
+bool Preprocessor::isActive() const {
+  return Conditionals.empty() || Conditionals.back().Active;
+}
+
+bool Preprocessor::isExpanding(std::string_view Name) const {
+  return std::any_of(Sources.begin(), Sources.end(),
+                     [Name](const Source &From) {
+                       return From.Expanding == Name;
+                     });
+}
+
+bool Preprocessor::expandMacro(const Token &Name, const Macro &Definition) {
+  std::vector<std::vector<Token>> Args;
+  if (Definition.FunctionLike) {
+    // Just an identifier unless it's followed by arguments.
+    Token Tok;
+    if (!next(Tok))
+      return false;
+
+    if (Tok.Kind != TokenKind::TK_OpenParen) {
+      putBack(Tok);
+      return false;
+    }
+
+    Args.emplace_back();
+    size_t Depth = 0;
+    while (true) {
+      if (!next(Tok))
+        throw ParseException(
+            fmt::format("Unterminated call to macro {}.", Name.Value));
+
+      if (Tok.Kind == TokenKind::TK_OpenParen) {
+        ++Depth;
+      } else if (Tok.Kind == TokenKind::TK_CloseParen) {
+        if (Depth == 0)
+          break;
+        --Depth;
+      } else if (Tok.Kind == TokenKind::TK_Comma && Depth == 0) {
+        Args.emplace_back();
+        continue;
+      }
+
+      Args.back().push_back(Tok);
+    }
+
+    if (Definition.Params.empty() && Args.size() == 1 && Args.front().empty())
+      Args.clear();
+
+    if (Args.size() != Definition.Params.size())
+      throw ParseException(
+          fmt::format("Macro {} takes {} arguments but was given {}.",
+                      Name.Value, Definition.Params.size(), Args.size()));
+  }
+
+  const auto paramIndex = [&Definition](const Token &Tok) {
+    const auto &Params = Definition.Params;
+    if (!isIdentifierLike(Tok))
+      return Params.size();
+
+    return static_cast<size_t>(
+        std::find(Params.begin(), Params.end(), Tok.Value) - Params.begin());
+  };
+
+  // Arguments are fully expanded before substitution, unless they're an
+  // operand of # or ##.
+  std::vector<std::vector<Token>> ExpandedArgs(Args.size());
+  std::vector<bool> IsExpanded(Args.size());
+
+  const auto &Body = Definition.Body;
+  std::vector<Token> Result;
+  // Whether the last thing substituted was an empty argument, which ## then
+  // has nothing to paste onto.
+  bool LastWasEmpty = false;
+  for (size_t Index = 0; Index < Body.size(); ++Index) {
+    const auto &Tok = Body[Index];
+
+    if (Definition.FunctionLike && Tok.Kind == TokenKind::TK_Hash) {
+      const auto Param =
+          Index + 1 < Body.size() ? paramIndex(Body[Index + 1]) : Args.size();
+      if (Param == Args.size())
+        throw ParseException("# is not followed by a macro parameter.");
+
+      Result.push_back(stringify(Args[Param]));
+      LastWasEmpty = false;
+      ++Index;
+      continue;
+    }
+
+    if (Tok.Kind == TokenKind::TK_HashHash) {
+      // Bodies are validated when they're defined, but never read past the
+      // end of one.
+      if (Index + 1 == Body.size())
+        throw ParseException("## cannot appear at either end of a macro body.");
+      const auto &Operand = Body[++Index];
+      const auto Param = paramIndex(Operand);
+      std::vector<Token> Right;
+      if (Param < Args.size())
+        Right = Args[Param];
+      else
+        Right.push_back(Operand);
+
+      if (Right.empty())
+        continue;
+
+      auto Begin = Right.begin();
+      if (!LastWasEmpty && !Result.empty()) {
+        Result.back() = paste(Result.back(), Right.front());
+        ++Begin;
+      }
+
+      Result.insert(Result.end(), Begin, Right.end());
+      LastWasEmpty = false;
+      continue;
+    }
+
+    const auto Param = paramIndex(Tok);
+    if (Param == Args.size()) {
+      Result.push_back(Tok);
+      LastWasEmpty = false;
+      continue;
+    }
+
+    const bool Pasted = Index + 1 < Body.size() &&
+                        Body[Index + 1].Kind == TokenKind::TK_HashHash;
+    if (!Pasted && !IsExpanded[Param]) {
+      ExpandedArgs[Param] = expandTokens(Args[Param]);
+      IsExpanded[Param] = true;
+    }
+
+    const auto &Substitution = Pasted ? Args[Param] : ExpandedArgs[Param];
+    Result.insert(Result.end(), Substitution.begin(), Substitution.end());
+    LastWasEmpty = Substitution.empty();
+  }
+
+  // Rescan the result with this macro disabled.
+  auto &Top = Sources.emplace_back();
+  Top.Expansion = std::move(Result);
+  Top.Expanding = Name.Value;
+  return true;
+}
+
+std::vector<Token> Preprocessor::expandTokens(std::vector<Token> Tokens) {
+  auto &Top = Sources.emplace_back();
+  Top.Expansion = std::move(Tokens);
+  Top.Barrier = true;
+
+  std::vector<Token> Expanded;
+  Token Tok;
+  while (lex(Tok))
+    Expanded.push_back(Tok);
+
+  assert(Sources.back().Barrier);
+  Sources.pop_back();
+  return Expanded;
+}
+
+bool Preprocessor::evaluateCondition(std::vector<Token> &Line) {
+  // Resolve defined before expanding so that its operand is left alone.
+  std::vector<Token> Resolved;
+  for (size_t Index = 0; Index < Line.size(); ++Index) {
+    if (Line[Index].Kind != TokenKind::TK_Identifier ||
+        Line[Index].Value != "defined") {
+      Resolved.push_back(Line[Index]);
+      continue;
+    }
+
+    const bool Paren = Index + 1 < Line.size() &&
+                       Line[Index + 1].Kind == TokenKind::TK_OpenParen;
+    const auto NameIndex = Index + (Paren ? 2 : 1);
+    if (NameIndex >= Line.size() || !isIdentifierLike(Line[NameIndex]) ||
+        (Paren && (NameIndex + 1 == Line.size() ||
+                   Line[NameIndex + 1].Kind != TokenKind::TK_CloseParen)))
+      throw ParseException("Expected macro name after defined.");
+
+    auto &Defined = Resolved.emplace_back();
+    Defined.assign(TokenKind::TK_IntegerLiteral,
+                   Macros.count(Line[NameIndex].Value) ? "1" : "0");
+    Index = NameIndex + (Paren ? 1 : 0);
+  }
+
+  return ConditionEvaluator(expandTokens(std::move(Resolved))).evaluate();
+}
+
+Token Preprocessor::paste(const Token &Left, const Token &Right) {
+  auto Tokens = lexSpelling(spell(Left) + spell(Right));
+  if (Tokens.size() != 1)
+    throw ParseException(
+        fmt::format("Pasting {} and {} does not give a valid token.",
+                    spell(Left), spell(Right)));
+
+  return Tokens.front();
+}
+
+Token Preprocessor::stringify(const std::vector<Token> &Tokens) {
+  std::string Spelling;
+  for (const auto &Tok : Tokens) {
+    if (Tok.LeadingSpace && !Spelling.empty())
+      Spelling.push_back(' ');
+    Spelling.append(spell(Tok));
+  }
+
+  Token Result;
+  Result.assign(TokenKind::TK_StringLiteral,
+                Spellings.emplace_back(std::move(Spelling)));
+  return Result;
+}
+
+std::vector<Token> Preprocessor::lexSpelling(std::string Text) {
+  std::vector<Token> Tokens;
+  const auto &Spelling = Spellings.emplace_back(terminate(std::move(Text)));
+  auto &L = SpellingLexers.emplace_back(Spelling.data(),
+                                        Spelling.data() + Spelling.size() - 1);
+  Token Tok;
+  while (L.lex(Tok))
+    Tokens.push_back(Tok);
+
+  return Tokens;
+}
+
+} // namespace fantac::parse
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Lexer.h"
+#include "ParseInterfaces.h"
+#include "Token.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fantac::parse {
+
+// An included file, lexed up front so that every translation unit including
+// it can replay its tokens rather than lexing it again.
+struct IncludeFile {
+  IncludeFile(std::string Path, std::string Contents);
+
+  const std::string Path;
+  const std::string Contents;
+  std::vector<Token> Tokens;
+  // Set when the whole file is wrapped in #ifndef Guard ... #endif, in which
+  // case it can be skipped entirely while Guard is defined.
+  std::string_view Guard;
+
+private:
+  // Owns any unescaped literals the tokens refer to.
+  std::unique_ptr<Lexer> FileLexer;
+};
+
+// Sits between the lexer and the parser, handling directives and expanding
+// macros. Supports #include, object and function-like #define with # and ##,
+// #undef, #if, #ifdef, #ifndef, #elif, #else, #endif, #error and
+// #pragma once. Other pragmas are ignored.
+class Preprocessor : public ILexer {
+public:
+  struct Macro {
+    bool FunctionLike = false;
+    std::vector<std::string_view> Params;
+    std::vector<Token> Body;
+  };
+
+  Preprocessor(ILexer &, std::string Path, IIncludeLoader &);
+  virtual ~Preprocessor() = default;
+
+  // Defines an object-like macro, like -D on the command line.
+  void define(std::string_view Name, std::string_view Value);
+  // Throws a ParseException if a definition can't be expanded, whether it
+  // came from #define, -D or a prelude.
+  static void validate(const Macro &);
+  // Defines a macro made elsewhere, which must have been validated. The name
+  // and the tokens must outlive the preprocessor.
+  void define(std::string_view Name, std::shared_ptr<const Macro>);
+  const std::unordered_map<std::string_view, std::shared_ptr<const Macro>> &
+  getMacros() const {
+    return Macros;
+  }
+
+  // ILexer impl.
+  bool lex(Token &) override;
+
+private:
+  // Somewhere tokens are read from. Either a streaming lexer for the main file,
+  // the cached tokens of an included file or the result of a macro expansion.
+  struct Source {
+    ILexer *Lexer = nullptr;
+    std::shared_ptr<const IncludeFile> File;
+    std::vector<Token> Expansion;
+    size_t Position = 0;
+    // Macro that this expansion came from. It isn't expanded again until the
+    // expansion has been read.
+    std::string_view Expanding;
+    // Stops reads from falling through to the sources below. Used to expand
+    // macro arguments and #if conditions in isolation.
+    bool Barrier = false;
+    // A token that was read and then put back.
+    Token Pending;
+    bool HasPending = false;
+    std::string_view Path;
+    size_t ConditionalDepth = 0;
+
+    bool isFile() const { return Lexer || File; }
+  };
+
+  struct Conditional {
+    // Whether tokens are currently being kept.
+    bool Active;
+    // Whether a branch has been taken yet, so later ones are skipped.
+    bool Taken;
+    bool SeenElse;
+  };
+
+  bool next(Token &);
+  bool readSourceToken(Source &, Token &);
+  void putBack(const Token &);
+  void readDirectiveLine(std::vector<Token> &);
+  void handleDirective();
+  void handleInclude(std::vector<Token> &);
+  void handleDefine(std::vector<Token> &);
+  void handleConditional(std::string_view Directive, std::vector<Token> &);
+  bool isActive() const;
+  bool isExpanding(std::string_view Name) const;
+  bool expandMacro(const Token &Name, const Macro &);
+  std::vector<Token> expandTokens(std::vector<Token>);
+  bool evaluateCondition(std::vector<Token> &);
+  Token paste(const Token &Left, const Token &Right);
+  Token stringify(const std::vector<Token> &);
+  std::vector<Token> lexSpelling(std::string);
+
+  IIncludeLoader &Loader;
+  std::vector<Source> Sources;
+  std::vector<Conditional> Conditionals;
+  std::unordered_map<std::string_view, std::shared_ptr<const Macro>> Macros;
+  // Files that have asked to only be included once, by path.
+  std::unordered_set<std::string_view> OnceOnly;
+  // Keeps included files alive while macros or tokens refer to them.
+  std::vector<std::shared_ptr<const IncludeFile>> Included;
+  // Backing storage for tokens made by the preprocessor itself, along with
+  // their lexers. Deque so that tokens viewing earlier entries stay valid.
+  std::deque<std::string> Spellings;
+  std::deque<Lexer> SpellingLexers;
+  const std::string MainPath;
+};
+
+} // namespace fantac::parse
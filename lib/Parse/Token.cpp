@@ -4,7 +4,7 @@ namespace fantac::parse {
 
 void Token::assign(TokenKind Kind) {
   this->Kind = Kind;
-  Value.clear();
+  Value = std::string_view();
 }
 
 std::string tokenKindToString(TokenKind Kind) {
@@ -125,6 +125,8 @@ std::string tokenKindToString(TokenKind Kind) {
     return "SingleLineComment";
   case TokenKind::TK_Hash:
     return "Hash";
+  case TokenKind::TK_HashHash:
+    return "HashHash";
   case TokenKind::TK_Void:
     return "Void";
   case TokenKind::TK_Char:
@@ -3,6 +3,7 @@
 #include <fmt/format.h>
 
 #include <string>
+#include <string_view>
 
 namespace fantac::parse {
 
@@ -75,6 +76,7 @@ enum class TokenKind {
   TK_SingleLineComment,
   // Preprocessor.
   TK_Hash,
+  TK_HashHash,
   // Types.
   TK_Void,
   TK_Char,
@@ -91,16 +93,23 @@ enum class TokenKind {
   TK_None
 };
 
+// Tokens don't own their text. Value views either the source buffer or, for
+// literals that needed unescaping, storage owned by the lexer. Either way it
+// stays valid for as long as the lexer and its source are alive.
 struct Token {
-  template <typename T> void assign(TokenKind Kind, T &&Value) {
+  void assign(TokenKind Kind, std::string_view Value) {
     this->Kind = Kind;
-    this->Value = std::forward<T>(Value);
+    this->Value = Value;
   }
 
   void assign(TokenKind Kind);
 
   TokenKind Kind = TokenKind::TK_None;
-  std::string Value;
+  std::string_view Value;
+  // Whether the token is the first on its line and whether whitespace comes
+  // before it. Only the preprocessor cares about these.
+  bool StartOfLine = false;
+  bool LeadingSpace = false;
 };
 
 std::string tokenKindToString(TokenKind Kind);
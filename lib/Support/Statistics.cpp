@@ -0,0 +1,62 @@
+#include "Statistics.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace fantac::stats {
+
+#if FANTAC_STATS
+
+namespace {
+
+struct Registry {
+  std::mutex Mutex;
+  std::vector<const Counter *> Counters;
+};
+
+// Counters may be constructed before any other global, so the registry is
+// made on first use.
+Registry &registry() {
+  static Registry Instance;
+  return Instance;
+}
+
+} // namespace
+
+Counter::Counter(const char *Group, std::string Description)
+    : Group(Group), Description(std::move(Description)) {
+  auto &R = registry();
+  std::lock_guard<std::mutex> Lock(R.Mutex);
+  R.Counters.push_back(this);
+}
+
+void print() {
+  auto &R = registry();
+  std::lock_guard<std::mutex> Lock(R.Mutex);
+  auto Counters = R.Counters;
+  std::stable_sort(Counters.begin(), Counters.end(),
+                   [](const Counter *Left, const Counter *Right) {
+                     return std::string_view(Left->Group) <
+                            std::string_view(Right->Group);
+                   });
+
+  fmt::print("{:>12}  {:<8}  {}\n", "Count", "Group", "Event");
+  for (const auto *C : Counters)
+    if (const auto Value = C->Value.load(std::memory_order_relaxed))
+      fmt::print("{:>12}  {:<8}  {}\n", Value, C->Group, C->Description);
+}
+
+#else
+
+void print() {
+  fmt::print("Statistics aren't compiled into this build. Reconfigure with "
+             "-DFANTAC_ENABLE_STATS=ON to count them.\n");
+}
+
+#endif
+
+} // namespace fantac::stats
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(NDEBUG) || defined(FANTAC_ENABLE_STATS)
+#define FANTAC_STATS 1
+#else
+#define FANTAC_STATS 0
+#endif
+
+#if FANTAC_STATS
+#include <atomic>
+#include <deque>
+#include <string>
+#endif
+
+namespace fantac::stats {
+
+// Counters of front end events for --stats. Counting on every token isn't
+// free, so they're only compiled in along with assertions or when
+// FANTAC_ENABLE_STATS is defined, and do nothing otherwise.
+constexpr bool Enabled = FANTAC_STATS;
+
+#if FANTAC_STATS
+
+// Number of times an event happened, summed over every thread. Counters
+// register themselves for printing when they're constructed, so they should
+// be globals or function local statics.
+class Counter {
+public:
+  Counter(const char *Group, std::string Description);
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+  void add(uint64_t Count = 1) {
+    Value.fetch_add(Count, std::memory_order_relaxed);
+  }
+
+private:
+  friend void print();
+
+  const char *const Group;
+  const std::string Description;
+  std::atomic<uint64_t> Value{0};
+};
+
+// Counts an event separately for each value of an enum, such as a token's
+// kind, naming each counter after the value.
+class KindCounter {
+public:
+  template <typename KindT, typename NameT>
+  KindCounter(const char *Group, const char *Description, KindT NumKinds,
+              NameT &&KindName) {
+    for (size_t Kind = 0; Kind < static_cast<size_t>(NumKinds); ++Kind)
+      Counters.emplace_back(Group,
+                            std::string(Description) + " " +
+                                KindName(static_cast<KindT>(Kind)));
+  }
+
+  template <typename KindT> void add(KindT Kind) {
+    Counters[static_cast<size_t>(Kind)].add();
+  }
+
+private:
+  std::deque<Counter> Counters;
+};
+
+#else
+
+class Counter {
+public:
+  constexpr Counter(const char *, const char *) {}
+  void add(uint64_t = 1) {}
+};
+
+class KindCounter {
+public:
+  template <typename KindT, typename NameT>
+  constexpr KindCounter(const char *, const char *, KindT, NameT &&) {}
+  template <typename KindT> void add(KindT) {}
+};
+
+#endif
+
+// Prints every counter that's been hit to stdout, grouped by where they're
+// counted.
+void print();
+
+} // namespace fantac::stats
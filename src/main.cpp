@@ -2,13 +2,197 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+bool parseJobs(std::string_view Value, unsigned int &Jobs) {
+  const auto Result =
+      std::from_chars(Value.data(), Value.data() + Value.size(), Jobs);
+  if (Result.ec != std::errc() || Result.ptr != Value.data() + Value.size())
+    return false;
+
+  // -j0 uses every core.
+  if (Jobs == 0)
+    Jobs = std::max(std::thread::hardware_concurrency(), 1u);
+
+  return true;
+}
+
+// -D NAME on its own defines NAME as 1.
+void parseDefine(std::string_view Value, fantac::Options &Opts) {
+  const auto Equals = Value.find('=');
+  if (Equals == std::string_view::npos)
+    Opts.Defines.emplace_back(Value, "1");
+  else
+    Opts.Defines.emplace_back(Value.substr(0, Equals),
+                              Value.substr(Equals + 1));
+}
+
+bool parseArgs(int argc, char **argv, fantac::Options &Opts) {
+  for (int Index = 1; Index < argc; ++Index) {
+    const std::string_view Arg = argv[Index];
+
+    if (Arg == "-j") {
+      if (++Index == argc || !parseJobs(argv[Index], Opts.Jobs))
+        return false;
+    } else if (Arg.substr(0, 2) == "-j") {
+      if (!parseJobs(Arg.substr(2), Opts.Jobs))
+        return false;
+    } else if (Arg == "--codegen-jobs") {
+      if (++Index == argc || !parseJobs(argv[Index], Opts.CodeGenJobs))
+        return false;
+    } else if (Arg.size() == 3 && Arg.substr(0, 2) == "-O" && Arg[2] >= '0' &&
+               Arg[2] <= '3') {
+      Opts.OptLevel = Arg[2] - '0';
+    } else if (Arg == "-S") {
+      Opts.Emit = fantac::EmitKind::EK_Assembly;
+    } else if (Arg == "-c") {
+      Opts.Emit = fantac::EmitKind::EK_Object;
+    } else if (Arg == "--emit-llvm-bc") {
+      Opts.Emit = fantac::EmitKind::EK_Bitcode;
+    } else if (Arg == "--emit-prelude") {
+      Opts.Emit = fantac::EmitKind::EK_Prelude;
+    } else if (Arg == "--emit-ast") {
+      Opts.Emit = fantac::EmitKind::EK_AST;
+    } else if (Arg == "--prelude") {
+      if (++Index == argc)
+        return false;
+      Opts.PreludeFileName = argv[Index];
+    } else if (Arg == "--stream") {
+      Opts.Stream = true;
+    } else if (Arg == "--pipeline") {
+      Opts.Pipeline = true;
+    } else if (Arg == "--time-report") {
+      Opts.TimeReportFormat = fantac::ReportFormat::RF_Table;
+    } else if (Arg == "--time-report=json") {
+      Opts.TimeReportFormat = fantac::ReportFormat::RF_JSON;
+    } else if (Arg == "--stats") {
+      Opts.Stats = true;
+    } else if (Arg == "--trace-out") {
+      if (++Index == argc)
+        return false;
+      Opts.TraceFileName = argv[Index];
+    } else if (Arg == "--run") {
+      Opts.Run = true;
+    } else if (Arg == "--lazy") {
+      Opts.Lazy = true;
+    } else if (Arg == "--entry") {
+      if (++Index == argc)
+        return false;
+      Opts.EntryName = argv[Index];
+    } else if (Arg == "--cache-dir") {
+      if (++Index == argc)
+        return false;
+      Opts.CacheDirectory = argv[Index];
+    } else if (Arg == "-I") {
+      if (++Index == argc)
+        return false;
+      Opts.IncludeDirectories.emplace_back(argv[Index]);
+    } else if (Arg.substr(0, 2) == "-I") {
+      Opts.IncludeDirectories.emplace_back(Arg.substr(2));
+    } else if (Arg == "-D") {
+      if (++Index == argc)
+        return false;
+      parseDefine(argv[Index], Opts);
+    } else if (Arg.substr(0, 2) == "-D") {
+      parseDefine(Arg.substr(2), Opts);
+    } else if (Arg == "-o") {
+      if (++Index == argc)
+        return false;
+      Opts.OutputFileName = argv[Index];
+    } else if (Arg.size() > 1 && Arg.front() == '-') {
+      fmt::print("Unknown option: {}.\n", Arg);
+      return false;
+    } else {
+      Opts.FileNames.emplace_back(Arg);
+    }
+  }
+
+  if (Opts.Lazy && !Opts.Run) {
+    fmt::print("Cannot use --lazy without --run.\n");
+    return false;
+  }
+
+  if (Opts.Run && !Opts.OutputFileName.empty()) {
+    fmt::print("Cannot use -o with --run.\n");
+    return false;
+  }
+
+  if (Opts.Run && !Opts.CacheDirectory.empty()) {
+    fmt::print("Cannot use --cache-dir with --run.\n");
+    return false;
+  }
+
+  if (Opts.Stream && Opts.Run) {
+    fmt::print("Cannot use --stream with --run.\n");
+    return false;
+  }
+
+  // Bitcode, preludes and ASTs are written from the whole file at once.
+  if (Opts.Stream && (Opts.Emit == fantac::EmitKind::EK_Bitcode ||
+                      Opts.Emit == fantac::EmitKind::EK_Prelude ||
+                      Opts.Emit == fantac::EmitKind::EK_AST)) {
+    fmt::print("Cannot use --stream with --emit-llvm-bc, --emit-prelude or "
+               "--emit-ast.\n");
+    return false;
+  }
+
+  if (Opts.Stream && !Opts.CacheDirectory.empty()) {
+    fmt::print("Cannot use --cache-dir with --stream.\n");
+    return false;
+  }
+
+  if (Opts.Pipeline && !Opts.CacheDirectory.empty()) {
+    fmt::print("Cannot use --cache-dir with --pipeline.\n");
+    return false;
+  }
+
+  // The pipeline parses ahead into the arena, so it can't be freed after each
+  // function, and memory would no longer be bounded.
+  if (Opts.Stream && Opts.Pipeline) {
+    fmt::print("Cannot use --stream with --pipeline.\n");
+    return false;
+  }
+
+  if (Opts.CodeGenJobs > 1 &&
+      (Opts.Run || Opts.Stream || !Opts.CacheDirectory.empty())) {
+    fmt::print("Cannot use --codegen-jobs with --run, --stream or "
+               "--cache-dir.\n");
+    return false;
+  }
+
+  if (!Opts.OutputFileName.empty() && Opts.FileNames.size() > 1) {
+    fmt::print("Cannot use -o with multiple input files.\n");
+    return false;
+  }
+
+  return !Opts.FileNames.empty();
+}
+
+} // namespace
+
 int main(int argc, char **argv) {
-  // Just use the first argument as the filename.
-  if (argc < 2) {
-    fmt::print("Usage: ./fantac [PATH]\n");
+  fantac::Options Opts;
+  if (!parseArgs(argc, argv, Opts)) {
+    fmt::print("Usage: ./fantac [-j N] [--codegen-jobs N] [-O0|-O1|-O2|-O3] "
+               "[-S|-c|--emit-llvm-bc|--emit-prelude|--emit-ast|"
+               "--run [--lazy] [--entry NAME]] [--stream] [--pipeline] "
+               "[--time-report[=json]] [--trace-out FILE] [--stats] "
+               "[--cache-dir DIR] [--prelude FILE] [-I DIR]... "
+               "[-D NAME[=VALUE]]... "
+               "[-o FILE] [PATH]...\n");
+    fmt::print("--codegen-jobs N generates a file's functions on N threads. "
+               "Calls between functions on different threads aren't "
+               "inlined.\n");
     return 1;
   }
 
-  fantac::run(argv[1]);
-  return 0;
+  if (Opts.Run)
+    return fantac::execute(Opts);
+
+  return fantac::run(Opts) ? 0 : 1;
 }